@@ -0,0 +1,127 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include "allocator.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <fstream>
+#include <new>
+#include <sstream>
+#include <string>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace fasttext {
+
+namespace allocator {
+
+  // round a row of n elements up to a whole number of SIMD registers
+  int64_t padded(int64_t n, int64_t elementSize) {
+    int64_t width = SIMD_BYTES / elementSize;
+    return (n + width - 1) / width * width;
+  }
+
+  int64_t rounded(int64_t size) {
+    if (size < HUGE_PAGE_SIZE) {
+      return (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    }
+    return (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+  }
+
+#ifdef __linux__
+  // Large blocks are mapped directly: explicit huge pages when the system
+  // has some reserved, otherwise a 2MB aligned mapping that we ask the
+  // kernel to back with transparent huge pages. Either way the pages are
+  // zero and not touched yet, so NUMA policies still apply. Explicit huge
+  // pages are taken up front, so sparse blocks only use the latter.
+  void* map(int64_t size, bool sparse) {
+    void* ptr;
+    if (!sparse) {
+      ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+      if (ptr != MAP_FAILED) return ptr;
+    }
+    ptr = mmap(nullptr, size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED) throw std::bad_alloc();
+    uintptr_t begin = uintptr_t(ptr);
+    uintptr_t aligned = (begin + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    if (aligned > begin) {
+      munmap(ptr, aligned - begin);
+    }
+    munmap((void*) (aligned + size), begin + HUGE_PAGE_SIZE - aligned);
+    madvise((void*) aligned, size, MADV_HUGEPAGE);
+    return (void*) aligned;
+  }
+#endif
+
+  // zero-initialized storage aligned to a cache line
+  void* allocate(int64_t bytes, bool sparse) {
+    int64_t size = rounded(bytes);
+#ifdef __linux__
+    if (size >= HUGE_PAGE_SIZE) {
+      return map(size, sparse);
+    }
+#endif
+    void* ptr = nullptr;
+    if (posix_memalign(&ptr, ALIGNMENT, size) != 0) {
+      throw std::bad_alloc();
+    }
+    memset(ptr, 0, size);
+    return ptr;
+  }
+
+  void deallocate(void* ptr, int64_t bytes) {
+    if (ptr == nullptr) return;
+#ifdef __linux__
+    int64_t size = rounded(bytes);
+    if (size >= HUGE_PAGE_SIZE) {
+      munmap(ptr, size);
+      return;
+    }
+#endif
+    free(ptr);
+  }
+
+  // number of huge pages currently backing a block, as seen in smaps
+  int64_t hugePages(const void* ptr, int64_t bytes) {
+    int64_t kb = 0;
+#ifdef __linux__
+    int64_t size = rounded(bytes);
+    if (size < HUGE_PAGE_SIZE) return 0;
+    std::ifstream ifs("/proc/self/smaps");
+    std::string line;
+    bool inside = false;
+    while (std::getline(ifs, line)) {
+      std::istringstream iss(line);
+      std::string key;
+      if (!(iss >> key)) continue;
+      if (key.back() != ':') {
+        // mapping header: "begin-end perms offset dev inode path"
+        uintptr_t begin = std::stoull(key, nullptr, 16);
+        uintptr_t end = std::stoull(key.substr(key.find('-') + 1), nullptr, 16);
+        inside = begin >= uintptr_t(ptr) && end <= uintptr_t(ptr) + size;
+        continue;
+      }
+      int64_t value;
+      if (inside && iss >> value && (key == "AnonHugePages:" ||
+          key == "Private_Hugetlb:" || key == "Shared_Hugetlb:")) {
+        kb += value;
+      }
+    }
+#endif
+    return kb * 1024 / HUGE_PAGE_SIZE;
+  }
+}
+
+}
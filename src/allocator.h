@@ -0,0 +1,31 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#ifndef FASTTEXT_ALLOCATOR_H
+#define FASTTEXT_ALLOCATOR_H
+
+#include <cstdint>
+
+namespace fasttext {
+
+namespace allocator {
+
+  const int64_t ALIGNMENT = 64;
+  const int64_t SIMD_BYTES = 32;
+  const int64_t HUGE_PAGE_SIZE = 1 << 21;
+
+  int64_t padded(int64_t, int64_t);
+  void* allocate(int64_t, bool = false);
+  void deallocate(void*, int64_t);
+  int64_t hugePages(const void*, int64_t);
+}
+
+}
+
+#endif
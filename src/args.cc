@@ -21,6 +21,7 @@ Args::Args() {
   dim = 100;
   ws = 5;
   epoch = 5;
+  timeBudget = 0;
   minCount = 1;
   minCountLabel = 0;
   neg = 5;
@@ -36,18 +37,44 @@ Args::Args() {
   label = "__label__";
   verbose = 2;
   pretrainedVectors = "";
+  inputModel = "";
+  numa = numa_policy::none;
+  replicaSync = 0;
+  pipeline = 0;
+  checkpoint = 0;
+  resume = false;
+  workers = 1;
+  rank = 0;
+  coordinator = "";
+  syncRate = 1000000;
+  storage = storage_type::fp32;
+  seed = 0;
+  vectorFormat = vector_format::vec;
+  dsub = 2;
+  qnorm = false;
+  qout = false;
+  cutoff = 0;
+  validation = "";
+  validationInterval = 10;
+  patience = 0;
+  classifierLr = 0.1;
+  classifierEpoch = 5;
+  classifierLoss = loss_name::softmax;
+  nlist = 0;
+  nprobe = 8;
+  indexFor = index_target::words;
 }
 
 void Args::parseArgs(int argc, char** argv) {
   std::string command(argv[1]);
-  if (command == "supervised") {
+  if (command == "supervised" || command == "autotune") {
     model = model_name::sup;
     loss = loss_name::softmax;
     minCount = 1;
     minn = 0;
     maxn = 0;
     lr = 0.1;
-  } else if (command == "pwv") { // polarized word vector model
+  } else if (command == "pwv" || command == "pwv-supervised") { // polarized word vector model
     model = model_name::pwv;
     loss = loss_name::polar;
     minCount = 1;
@@ -84,6 +111,8 @@ void Args::parseArgs(int argc, char** argv) {
       ws = atoi(argv[ai + 1]);
     } else if (strcmp(argv[ai], "-epoch") == 0) {
       epoch = atoi(argv[ai + 1]);
+    } else if (strcmp(argv[ai], "-timeBudget") == 0) {
+      timeBudget = atoi(argv[ai + 1]);
     } else if (strcmp(argv[ai], "-minCount") == 0) {
       minCount = atoi(argv[ai + 1]);
     } else if (strcmp(argv[ai], "-minCountLabel") == 0) {
@@ -120,6 +149,109 @@ void Args::parseArgs(int argc, char** argv) {
       verbose = atoi(argv[ai + 1]);
     } else if (strcmp(argv[ai], "-pretrainedVectors") == 0) {
       pretrainedVectors = std::string(argv[ai + 1]);
+    } else if (strcmp(argv[ai], "-inputModel") == 0) {
+      inputModel = std::string(argv[ai + 1]);
+    } else if (strcmp(argv[ai], "-numa") == 0) {
+      if (strcmp(argv[ai + 1], "none") == 0) {
+        numa = numa_policy::none;
+      } else if (strcmp(argv[ai + 1], "interleave") == 0) {
+        numa = numa_policy::interleave;
+      } else if (strcmp(argv[ai + 1], "partition") == 0) {
+        numa = numa_policy::partition;
+      } else {
+        std::cout << "Unknown numa policy: " << argv[ai + 1] << std::endl;
+        printHelp();
+        exit(EXIT_FAILURE);
+      }
+    } else if (strcmp(argv[ai], "-replicaSync") == 0) {
+      replicaSync = atoi(argv[ai + 1]);
+    } else if (strcmp(argv[ai], "-pipeline") == 0) {
+      pipeline = atoi(argv[ai + 1]);
+    } else if (strcmp(argv[ai], "-checkpoint") == 0) {
+      checkpoint = atoi(argv[ai + 1]);
+    } else if (strcmp(argv[ai], "-resume") == 0) {
+      resume = true;
+      ai--;
+    } else if (strcmp(argv[ai], "-workers") == 0) {
+      workers = atoi(argv[ai + 1]);
+    } else if (strcmp(argv[ai], "-rank") == 0) {
+      rank = atoi(argv[ai + 1]);
+    } else if (strcmp(argv[ai], "-coordinator") == 0) {
+      coordinator = std::string(argv[ai + 1]);
+    } else if (strcmp(argv[ai], "-syncRate") == 0) {
+      syncRate = atoi(argv[ai + 1]);
+    } else if (strcmp(argv[ai], "-storage") == 0) {
+      if (strcmp(argv[ai + 1], "fp32") == 0) {
+        storage = storage_type::fp32;
+      } else if (strcmp(argv[ai + 1], "fp16") == 0) {
+        storage = storage_type::fp16;
+      } else if (strcmp(argv[ai + 1], "bf16") == 0) {
+        storage = storage_type::bf16;
+      } else {
+        std::cout << "Unknown storage: " << argv[ai + 1] << std::endl;
+        printHelp();
+        exit(EXIT_FAILURE);
+      }
+    } else if (strcmp(argv[ai], "-seed") == 0) {
+      seed = atoi(argv[ai + 1]);
+    } else if (strcmp(argv[ai], "-vectorFormat") == 0) {
+      if (strcmp(argv[ai + 1], "vec") == 0) {
+        vectorFormat = vector_format::vec;
+      } else if (strcmp(argv[ai + 1], "bvec") == 0) {
+        vectorFormat = vector_format::bvec;
+      } else if (strcmp(argv[ai + 1], "both") == 0) {
+        vectorFormat = vector_format::both;
+      } else {
+        std::cout << "Unknown vector format: " << argv[ai + 1] << std::endl;
+        printHelp();
+        exit(EXIT_FAILURE);
+      }
+    } else if (strcmp(argv[ai], "-dsub") == 0) {
+      dsub = atoi(argv[ai + 1]);
+    } else if (strcmp(argv[ai], "-qnorm") == 0) {
+      qnorm = true;
+      ai--;
+    } else if (strcmp(argv[ai], "-qout") == 0) {
+      qout = true;
+      ai--;
+    } else if (strcmp(argv[ai], "-cutoff") == 0) {
+      cutoff = atoi(argv[ai + 1]);
+    } else if (strcmp(argv[ai], "-validation") == 0) {
+      validation = std::string(argv[ai + 1]);
+    } else if (strcmp(argv[ai], "-validationInterval") == 0) {
+      validationInterval = atoi(argv[ai + 1]);
+    } else if (strcmp(argv[ai], "-patience") == 0) {
+      patience = atoi(argv[ai + 1]);
+    } else if (strcmp(argv[ai], "-classifierLr") == 0) {
+      classifierLr = atof(argv[ai + 1]);
+    } else if (strcmp(argv[ai], "-classifierEpoch") == 0) {
+      classifierEpoch = atoi(argv[ai + 1]);
+    } else if (strcmp(argv[ai], "-classifierLoss") == 0) {
+      if (strcmp(argv[ai + 1], "hs") == 0) {
+        classifierLoss = loss_name::hs;
+      } else if (strcmp(argv[ai + 1], "ns") == 0) {
+        classifierLoss = loss_name::ns;
+      } else if (strcmp(argv[ai + 1], "softmax") == 0) {
+        classifierLoss = loss_name::softmax;
+      } else {
+        std::cout << "Unknown loss: " << argv[ai + 1] << std::endl;
+        printHelp();
+        exit(EXIT_FAILURE);
+      }
+    } else if (strcmp(argv[ai], "-nlist") == 0) {
+      nlist = atoi(argv[ai + 1]);
+    } else if (strcmp(argv[ai], "-nprobe") == 0) {
+      nprobe = atoi(argv[ai + 1]);
+    } else if (strcmp(argv[ai], "-indexFor") == 0) {
+      if (strcmp(argv[ai + 1], "words") == 0) {
+        indexFor = index_target::words;
+      } else if (strcmp(argv[ai + 1], "labels") == 0) {
+        indexFor = index_target::labels;
+      } else {
+        std::cout << "Unknown index target: " << argv[ai + 1] << std::endl;
+        printHelp();
+        exit(EXIT_FAILURE);
+      }
     } else {
       std::cout << "Unknown argument: " << argv[ai] << std::endl;
       printHelp();
@@ -127,7 +259,9 @@ void Args::parseArgs(int argc, char** argv) {
     }
     ai += 2;
   }
-  if (input.empty() || output.empty()) {
+  bool modelCommand = command == "quantize" || command == "prune" ||
+                      command == "index";
+  if ((input.empty() && !modelCommand) || output.empty()) {
     std::cout << "Empty input or output path." << std::endl;
     printHelp();
     exit(EXIT_FAILURE);
@@ -152,6 +286,7 @@ void Args::printHelp() {
     << "  -dim                size of word vectors [" << dim << "]\n"
     << "  -ws                 size of the context window [" << ws << "]\n"
     << "  -epoch              number of epochs [" << epoch << "]\n"
+    << "  -timeBudget         seconds for the whole run, training as many epochs as fit, 0 to train -epoch epochs [" << timeBudget << "]\n"
     << "  -minCount           minimal number of word occurences [" << minCount << "]\n"
     << "  -minCountLabel      minimal number of label occurences [" << minCountLabel << "]\n"
     << "  -neg                number of negatives sampled [" << neg << "]\n"
@@ -164,7 +299,38 @@ void Args::printHelp() {
     << "  -t                  sampling threshold [" << t << "]\n"
     << "  -label              labels prefix [" << label << "]\n"
     << "  -verbose            verbosity level [" << verbose << "]\n"
-    << "  -pretrainedVectors  pretrained word vectors for supervised learning []"
+    << "  -pretrainedVectors  pretrained word vectors for supervised learning, .vec or .bvec []\n"
+    << "  -inputModel         .bin model to train further, its vocabulary grown with the input []\n"
+    << "  -vectorFormat       format of the saved word vectors {vec, bvec, both} [vec]\n"
+    << "  -numa               matrix placement and thread pinning {none, interleave, partition} [none]\n"
+    << "  -replicaSync        tokens between averaging per-node output replicas, 0 to share one [" << replicaSync << "]\n"
+    << "  -pipeline           threads tokenizing for the training threads, 0 to tokenize in them [" << pipeline << "]\n"
+    << "  -checkpoint         seconds between checkpoints written to <output>.ckpt, 0 for none [" << checkpoint << "]\n"
+    << "  -resume             continue training from <output>.ckpt [" << resume << "]\n"
+    << "  -workers            processes training together, each on its share of the input [" << workers << "]\n"
+    << "  -rank               index of this process among -workers, 0 coordinates and saves [" << rank << "]\n"
+    << "  -coordinator        Unix socket path or host:port where rank 0 listens []\n"
+    << "  -syncRate           tokens between averaging the rows changed by the -workers [" << syncRate << "]\n"
+    << "  -validationInterval seconds between evaluations of the -validation file [" << validationInterval << "]\n"
+    << "  -patience           evaluations without a better P@1 before stopping, 0 to never stop [" << patience << "]\n"
+    << "  -storage            precision of the stored matrices {fp32, fp16, bf16} [fp32]\n"
+    << "  -seed               seed of the random number generators [" << seed << "]\n\n"
+    << "The following arguments are for quantization:\n"
+    << "  -dsub               size of each sub-vector [" << dsub << "]\n"
+    << "  -qnorm              quantize the norms separately [" << qnorm << "]\n"
+    << "  -qout               quantize the output matrix too [" << qout << "]\n\n"
+    << "The following arguments are for pruning:\n"
+    << "  -cutoff             number of word and ngram rows to keep [" << cutoff << "]\n"
+    << "  -validation         labeled file to rank rows by when pruning, or to evaluate while training []\n\n"
+    << "The following arguments are for the classifier of pwv-supervised (the others,\n"
+    << "-lr, -epoch and -loss included, are for its embedding):\n"
+    << "  -classifierLr       learning rate [" << classifierLr << "]\n"
+    << "  -classifierEpoch    number of epochs [" << classifierEpoch << "]\n"
+    << "  -classifierLoss     loss function {ns, hs, softmax} [softmax]\n\n"
+    << "The following arguments are for indexing:\n"
+    << "  -indexFor           rows to index {words, labels} [words]\n"
+    << "  -nlist              number of lists, 0 for about 2 sqrt(rows) [" << nlist << "]\n"
+    << "  -nprobe             lists scanned per query by default [" << nprobe << "]"
     << std::endl;
 }
 
@@ -182,9 +348,10 @@ void Args::save(std::ostream& out) {
   out.write((char*) &(maxn), sizeof(int));
   out.write((char*) &(lrUpdateRate), sizeof(int));
   out.write((char*) &(t), sizeof(double));
+  out.write((char*) &(storage), sizeof(storage_type));
 }
 
-void Args::load(std::istream& in) {
+void Args::load(std::istream& in, int32_t version) {
   in.read((char*) &(dim), sizeof(int));
   in.read((char*) &(ws), sizeof(int));
   in.read((char*) &(epoch), sizeof(int));
@@ -198,6 +365,10 @@ void Args::load(std::istream& in) {
   in.read((char*) &(maxn), sizeof(int));
   in.read((char*) &(lrUpdateRate), sizeof(int));
   in.read((char*) &(t), sizeof(double));
+  storage = storage_type::fp32;
+  if (version >= 1) {
+    in.read((char*) &(storage), sizeof(storage_type));
+  }
 }
 
 }
@@ -14,12 +14,17 @@
 #include <ostream>
 #include <string>
 
+#include "real.h"
+
 namespace fasttext {
 
 //enum class model_name : int {cbow=1, sg, sup};
 //enum class loss_name : int {hs=1, ns, softmax};
 enum class model_name : int {cbow=1, sg, sup, pwv};
 enum class loss_name : int {hs=1, ns, softmax, polar};
+enum class numa_policy : int {none=0, interleave, partition};
+enum class vector_format : int {vec=0, bvec, both};
+enum class index_target : int {words=0, labels};
 
 class Args {
   public:
@@ -32,6 +37,7 @@ class Args {
     int dim;
     int ws;
     int epoch;
+    int timeBudget;
     int minCount;
     int minCountLabel;
     int neg;
@@ -46,11 +52,37 @@ class Args {
     std::string label;
     int verbose;
     std::string pretrainedVectors;
+    std::string inputModel;
+    numa_policy numa;
+    int replicaSync;
+    int pipeline;
+    int checkpoint;
+    bool resume;
+    int workers;
+    int rank;
+    std::string coordinator;
+    int syncRate;
+    storage_type storage;
+    int seed;
+    vector_format vectorFormat;
+    int dsub;
+    bool qnorm;
+    bool qout;
+    int cutoff;
+    std::string validation;
+    int validationInterval;
+    int patience;
+    double classifierLr;
+    int classifierEpoch;
+    loss_name classifierLoss;
+    int nlist;
+    int nprobe;
+    index_target indexFor;
 
     void parseArgs(int, char**);
     void printHelp();
     void save(std::ostream&);
-    void load(std::istream&);
+    void load(std::istream&, int32_t);
 };
 
 }
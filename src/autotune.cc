@@ -0,0 +1,176 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include "autotune.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+#include "vector.h"
+
+namespace fasttext {
+
+const int32_t Autotune::RUNGS;
+const int32_t Autotune::MIN_PEERS;
+
+Autotune::Autotune(std::shared_ptr<Args> args, std::shared_ptr<Dictionary> dict,
+                   const LineBatch& corpus,
+                   const std::vector<std::vector<int32_t>>& vlines,
+                   const std::vector<std::vector<int32_t>>& vlabels,
+                   clock::time_point deadline)
+  : args_(args), dict_(dict), corpus_(corpus), vlines_(vlines),
+    vlabels_(vlabels), deadline_(deadline), rng_(args->seed),
+    ntrials_(0), npruned_(0) {
+  best_.precision = -1.0;
+}
+
+// the first trial is the command line, the others are drawn at random
+std::shared_ptr<Args> Autotune::sample() {
+  auto args = std::make_shared<Args>(*args_);
+  if (ntrials_ == 0) return args;
+  const int32_t dims[] = {10, 25, 50, 100, 200};
+  const int32_t buckets[] = {100000, 1000000, 2000000};
+  std::uniform_real_distribution<> uniform(0.0, 1.0);
+  args->lr = 0.01 * std::pow(100.0, uniform(rng_));
+  args->dim = dims[rng_() % 5];
+  args->epoch = int(std::pow(100.0, uniform(rng_))) + 1;
+  args->wordNgrams = rng_() % 3 + 1;
+  args->bucket = args->wordNgrams > 1 ? buckets[rng_() % 3] : 0;
+  return args;
+}
+
+// P@1 on the validation lines
+real Autotune::evaluate(const Trial& trial, Model& model) const {
+  if (vlines_.empty()) return 0.0;
+  Vector hidden(trial.args->dim);
+  Vector output(dict_->nlabels());
+  std::vector<std::pair<real, int32_t>> predictions;
+  std::vector<int32_t> line;
+  int64_t correct = 0;
+  for (size_t i = 0; i < vlines_.size(); i++) {
+    line = vlines_[i];
+    dict_->addNgrams(line, trial.args->wordNgrams, trial.args->bucket);
+    predictions.clear();
+    model.predict(line, 1, predictions, hidden, output);
+    if (!predictions.empty() &&
+        std::find(vlabels_[i].begin(), vlabels_[i].end(),
+                  predictions[0].second) != vlabels_[i].end()) {
+      correct++;
+    }
+  }
+  return real(correct) / vlines_.size();
+}
+
+// records the score of a trial at a rung; false when it should stop
+bool Autotune::promote(int32_t rung, Trial& trial) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  std::vector<real>& scores = scores_[rung];
+  bool keep = true;
+  if (rung < RUNGS - 1 && scores.size() >= MIN_PEERS) {
+    std::vector<real> sorted(scores);
+    std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2, sorted.end());
+    keep = trial.precision >= sorted[sorted.size() / 2];
+  }
+  scores.push_back(trial.precision);
+  if (!keep) {
+    npruned_++;
+  } else if (rung == RUNGS - 1 && trial.precision > best_.precision) {
+    best_ = trial;
+  }
+  return keep;
+}
+
+// single-threaded training of one trial, lines in file order and the
+// learning rate decaying over all of its epochs
+void Autotune::train(Trial& trial) {
+  const Args& args = *trial.args;
+  trial.input = std::make_shared<Matrix>(dict_->nwords() + args.bucket, args.dim, args.storage);
+  if (args.bucket > 0) {
+    trial.input->deferUniform(dict_->nwords(), 1.0 / args.dim, args.seed);
+  }
+  trial.input->uniform(1.0 / args.dim, args.seed);
+  trial.output = std::make_shared<Matrix>(dict_->nlabels(), args.dim, args.storage);
+  Model model(trial.input, trial.output, trial.args, args.seed + trial.id);
+  model.setTargetCounts(dict_->getCounts(entry_type::label));
+
+  const int64_t n = corpus_.size();
+  const int64_t total = n * args.epoch;
+  int32_t rung = 0;
+  std::vector<int32_t> line, labels;
+  for (int64_t step = 0; step < total; step++) {
+    if (step % 1024 == 0 && clock::now() >= deadline_) return;
+    corpus_.get(step % n, line, labels);
+    if (labels.size() > 0 && line.size() > 0) {
+      dict_->addNgrams(line, args.wordNgrams, args.bucket);
+      std::uniform_int_distribution<> uniform(0, labels.size() - 1);
+      model.update(line, labels[uniform(model.rng)], args.lr * (1.0 - real(step) / total));
+    }
+    // short trials reach several rungs on the same step
+    if (rung < RUNGS && step + 1 >= total >> (RUNGS - 1 - rung)) {
+      trial.precision = evaluate(trial, model);
+    }
+    while (rung < RUNGS && step + 1 >= total >> (RUNGS - 1 - rung)) {
+      bool keep = promote(rung, trial);
+      if (args_->verbose > 0) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        print(std::cout, trial);
+        std::cout << "  after " << (step + 1) / n << " epochs"
+                  << (keep ? "" : ", stopped") << std::endl;
+      }
+      if (!keep) return;
+      rung++;
+    }
+  }
+}
+
+void Autotune::worker() {
+  while (clock::now() < deadline_) {
+    Trial trial;
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      trial.id = ntrials_;
+      trial.args = sample();
+      ntrials_++;
+    }
+    train(trial);
+  }
+}
+
+void Autotune::print(std::ostream& out, const Trial& trial) const {
+  const Args& args = *trial.args;
+  out << "Trial " << std::setw(4) << trial.id << ":  -lr " << std::setprecision(3)
+      << args.lr << " -dim " << args.dim << " -epoch " << args.epoch
+      << " -wordNgrams " << args.wordNgrams << " -bucket " << args.bucket
+      << "  P@1: " << trial.precision;
+}
+
+Trial Autotune::run() {
+  std::vector<std::thread> threads;
+  for (int32_t i = 0; i < args_->thread; i++) {
+    threads.push_back(std::thread([=]() { worker(); }));
+  }
+  for (auto it = threads.begin(); it != threads.end(); ++it) {
+    it->join();
+  }
+  if (args_->verbose > 0) {
+    std::cout << "Trials: " << ntrials_ << ", " << npruned_ << " stopped early, "
+              << scores_[RUNGS - 1].size() << " finished" << std::endl;
+    if (best_.args) {
+      std::cout << "Best ";
+      print(std::cout, best_);
+      std::cout << std::endl;
+    }
+  }
+  return best_;
+}
+
+}
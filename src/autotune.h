@@ -0,0 +1,84 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#ifndef FASTTEXT_AUTOTUNE_H
+#define FASTTEXT_AUTOTUNE_H
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <random>
+#include <vector>
+
+#include "args.h"
+#include "dictionary.h"
+#include "matrix.h"
+#include "model.h"
+#include "pipeline.h"
+#include "real.h"
+
+namespace fasttext {
+
+struct Trial {
+  int32_t id;
+  std::shared_ptr<Args> args;
+  std::shared_ptr<Matrix> input;
+  std::shared_ptr<Matrix> output;
+  real precision;
+};
+
+// Random search over lr, dim, epoch, wordNgrams and bucket of supervised
+// models. Every thread trains one candidate at a time on its own matrices,
+// all of them reading the same dictionary and tokenized corpus. Trials are
+// evaluated on the validation lines after a quarter, half and all of
+// their epochs, and stopped when they score below the median of the trials
+// evaluated at the same point before them. Trials still running at the
+// deadline are dropped.
+class Autotune {
+  public:
+    typedef std::chrono::steady_clock clock;
+
+  private:
+    static const int32_t RUNGS = 3;
+    static const int32_t MIN_PEERS = 3; // scores needed before pruning
+
+    std::shared_ptr<Args> args_;
+    std::shared_ptr<Dictionary> dict_;
+    const LineBatch& corpus_;
+    const std::vector<std::vector<int32_t>>& vlines_;
+    const std::vector<std::vector<int32_t>>& vlabels_;
+    clock::time_point deadline_;
+
+    std::mutex mtx_;
+    std::minstd_rand rng_;
+    std::vector<real> scores_[RUNGS];
+    int32_t ntrials_;
+    int32_t npruned_;
+    Trial best_;
+
+    std::shared_ptr<Args> sample();
+    real evaluate(const Trial&, Model&) const;
+    bool promote(int32_t, Trial&);
+    void train(Trial&);
+    void worker();
+    void print(std::ostream&, const Trial&) const;
+
+  public:
+    Autotune(std::shared_ptr<Args>, std::shared_ptr<Dictionary>,
+             const LineBatch&, const std::vector<std::vector<int32_t>>&,
+             const std::vector<std::vector<int32_t>>&, clock::time_point);
+
+    Trial run();
+};
+
+}
+
+#endif
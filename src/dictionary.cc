@@ -10,6 +10,7 @@
 #include "dictionary.h"
 
 #include <assert.h>
+#include <string.h>
 
 #include <iostream>
 #include <algorithm>
@@ -17,6 +18,10 @@
 #include <unordered_map>
 #include <cctype>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 namespace fasttext {
 
 const std::string Dictionary::EOS = "</s>";
@@ -29,34 +34,42 @@ Dictionary::Dictionary(std::shared_ptr<Args> args) {
   nwords_ = 0;
   nlabels_ = 0;
   ntokens_ = 0;
-  word2int_.resize(MAX_VOCAB_SIZE);
-  for (int32_t i = 0; i < MAX_VOCAB_SIZE; i++) {
-    word2int_[i] = -1;
-  }
+  pruneidx_size_ = -1;
 }
 
 int32_t Dictionary::find(const std::string& w) const {
-  int32_t h = hash(w) % MAX_VOCAB_SIZE;
-  while (word2int_[h] != -1 && words_[word2int_[h]].word != w) {
-    h = (h + 1) % MAX_VOCAB_SIZE;
+  return find(w.data(), w.size());
+}
+
+int32_t Dictionary::find(const char* w, size_t n) const {
+  int32_t tableSize = word2int_.size();
+  int32_t h = hash(w, n) % tableSize;
+  while (word2int_[h] != -1) {
+    const std::string& word = words_[word2int_[h]].word;
+    if (word.size() == n && memcmp(word.data(), w, n) == 0) break;
+    h = (h + 1) % tableSize;
   }
   return h;
 }
 
 void Dictionary::add(const std::string& w) {
-  int32_t h = find(w);
+  add(w.data(), w.size());
+}
+
+void Dictionary::add(const char* w, size_t n) {
+  int32_t h = find(w, n);
   ntokens_++;
 
   if (word2int_[h] == -1) {
     entry e;
-    e.word = w;
+    e.word.assign(w, n);
     e.count = 1;
 
-    if( w.find(args_->label) == 0) {
-        cur_label_ = w;
+    if( e.word.find(args_->label) == 0) {
+        cur_label_ = e.word;
         e.type = entry_type::label;
         e.nlabels = 1;
-        e.labels.push_back(w);
+        e.labels.push_back(e.word);
     }
     else {
         e.type = entry_type::word;
@@ -66,15 +79,15 @@ void Dictionary::add(const std::string& w) {
     words_.push_back(e);
     word2int_[h] = size_++;
   } else {
-    auto e = words_[word2int_[h]];
+    entry& e = words_[word2int_[h]];
     if( e.type == entry_type::label ) {
       cur_label_ = e.word;
     }
     else if( std::find( e.labels.begin(), e.labels.end(), cur_label_) == e.labels.end() ) {
-        words_[word2int_[h]].labels.push_back(cur_label_);
-        ++(words_[word2int_[h]].nlabels);
+        e.labels.push_back(cur_label_);
+        ++(e.nlabels);
     }
-    words_[word2int_[h]].count++;
+    e.count++;
   }
 
 
@@ -92,6 +105,15 @@ int64_t Dictionary::ntokens() const {
   return ntokens_;
 }
 
+// number of tokens getLine reports over one pass of the training file
+int64_t Dictionary::nlineTokens() const {
+  int64_t n = 0;
+  for (auto& w : words_) {
+    if (w.word != EOS) n += w.count;
+  }
+  return n;
+}
+
 const std::vector<entry>& Dictionary::getWords() const{
         return words_;
 }
@@ -140,6 +162,11 @@ int32_t Dictionary::getId(const std::string& w) const {
   return word2int_[h];
 }
 
+int32_t Dictionary::getId(const char* w, size_t n) const {
+  int32_t h = find(w, n);
+  return word2int_[h];
+}
+
 entry_type Dictionary::getType(int32_t id) const {
   assert(id >= 0);
   assert(id < size_);
@@ -153,8 +180,12 @@ std::string Dictionary::getWord(int32_t id) const {
 }
 
 uint32_t Dictionary::hash(const std::string& str) const {
+  return hash(str.data(), str.size());
+}
+
+uint32_t Dictionary::hash(const char* str, size_t n) const {
   uint32_t h = 2166136261;
-  for (size_t i = 0; i < str.size(); i++) {
+  for (size_t i = 0; i < n; i++) {
     h = h ^ uint32_t(str[i]);
     h = h * 16777619;
   }
@@ -173,12 +204,22 @@ void Dictionary::computeNgrams(const std::string& word,
       }
       if (n >= args_->minn && !(n == 1 && (i == 0 || j == word.size()))) {
         int32_t h = hash(ngram) % args_->bucket;
-        ngrams.push_back(nwords_ + h);
+        pushHash(ngrams, h);
       }
     }
   }
 }
 
+// buckets dropped by prune() have no row left and are skipped
+void Dictionary::pushHash(std::vector<int32_t>& hashes, int32_t id) const {
+  if (pruneidx_size_ >= 0) {
+    auto it = pruneidx_.find(id);
+    if (it == pruneidx_.end()) return;
+    id = it->second;
+  }
+  hashes.push_back(nwords_ + id);
+}
+
 void Dictionary::initNgrams() {
   for (size_t i = 0; i < size_; i++) {
     std::string word = BOW + words_[i].word + EOW;
@@ -213,11 +254,57 @@ bool Dictionary::readWord(std::istream& in, std::string& word) const
   return !word.empty();
 }
 
-void Dictionary::readFromFile(std::istream& in) {
-  std::string word;
+static inline bool isDelimiter(char c) {
+  unsigned char u = c;
+  return u == ' ' || (u <= '\r' && (u >= '\t' || u == '\0'));
+}
+
+// first delimiter in [p, end), or end. All delimiters are bytes <= 0x20,
+// so 16 bytes at a time are screened for those and only hits are checked.
+static const char* findDelimiter(const char* p, const char* end) {
+#ifdef __SSE2__
+  const __m128i space = _mm_set1_epi8(0x20);
+  while (end - p >= 16) {
+    __m128i v = _mm_loadu_si128((const __m128i*) p);
+    uint32_t mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(v, space), v));
+    while (mask != 0) {
+      int32_t i = __builtin_ctz(mask);
+      if (isDelimiter(p[i])) return p + i;
+      mask &= mask - 1;
+    }
+    p += 16;
+  }
+#endif
+  while (p < end && !isDelimiter(*p)) p++;
+  return p;
+}
+
+// Same tokens as readWord(std::istream&), taken in place from [p, end):
+// word points into the buffer, or at EOS for a newline, and p moves past
+// the token. A newline ending a word is left for the next call.
+bool Dictionary::readWord(const char*& p, const char* end,
+                          const char*& word, size_t& len) const {
+  while (p < end && isDelimiter(*p)) {
+    if (*p++ == '\n') {
+      word = EOS.data();
+      len = EOS.size();
+      return true;
+    }
+  }
+  if (p == end) return false;
+  word = p;
+  p = findDelimiter(p, end);
+  len = p - word;
+  return true;
+}
+
+void Dictionary::readFromFile(const char* begin, const char* end) {
+  word2int_.assign(MAX_VOCAB_SIZE, -1);
+  const char* word;
+  size_t len;
   int64_t minThreshold = 1;
-  while (readWord(in, word)) {
-    add(word);
+  while (readWord(begin, end, word, len)) {
+    add(word, len);
     if (ntokens_ % 1000000 == 0 && args_->verbose > 1) {
       std::cout << "\rRead " << ntokens_  / 1000000 << "M words" << std::flush;
     }
@@ -240,6 +327,67 @@ void Dictionary::readFromFile(std::istream& in) {
   }
 }
 
+// Counts a new corpus into a loaded dictionary. Known entries keep their
+// ids relative to their type and take the new counts, so that progress and
+// sampling follow the new data; unknown ones that pass the thresholds are
+// added after the known ones of their type.
+void Dictionary::update(const char* begin, const char* end) {
+  int32_t known = size_;
+  int32_t knownWords = nwords_;
+  word2int_.assign(MAX_VOCAB_SIZE, -1);
+  for (int32_t i = 0; i < size_; i++) {
+    words_[i].count = 0;
+    words_[i].nlabels = 0;
+    words_[i].labels.clear();
+    words_[i].subwords.clear();
+    word2int_[find(words_[i].word)] = i;
+  }
+  ntokens_ = 0;
+  const char* word;
+  size_t len;
+  while (readWord(begin, end, word, len)) {
+    add(word, len);
+    if (ntokens_ % 1000000 == 0 && args_->verbose > 1) {
+      std::cout << "\rRead " << ntokens_  / 1000000 << "M words" << std::flush;
+    }
+  }
+  std::vector<entry> added(words_.begin() + known, words_.end());
+  sort(added.begin(), added.end(), [](const entry& e1, const entry& e2) {
+      if (e1.type != e2.type) return e1.type < e2.type;
+      return e1.count > e2.count;
+    });
+  added.erase(remove_if(added.begin(), added.end(), [&](const entry& e) {
+        return (e.type == entry_type::word && e.count < args_->minCount) ||
+               (e.type == entry_type::label && e.count < args_->minCountLabel);
+      }), added.end());
+  auto firstLabel = std::find_if(added.begin(), added.end(), [](const entry& e) {
+      return e.type == entry_type::label;
+    });
+  std::vector<entry> words(words_.begin(), words_.begin() + knownWords);
+  words.insert(words.end(), added.begin(), firstLabel);
+  words.insert(words.end(), words_.begin() + knownWords, words_.begin() + known);
+  words.insert(words.end(), firstLabel, added.end());
+  words_.swap(words);
+  size_ = 0;
+  nwords_ = 0;
+  nlabels_ = 0;
+  std::fill(word2int_.begin(), word2int_.end(), -1);
+  for (auto it = words_.begin(); it != words_.end(); ++it) {
+    word2int_[find(it->word)] = size_++;
+    if (it->type == entry_type::word) nwords_++;
+    if (it->type == entry_type::label) nlabels_++;
+  }
+  initTableDiscard();
+  initNgrams();
+  if (args_->verbose > 0) {
+    std::cout << "\rRead " << ntokens_  / 1000000 << "M words" << std::endl;
+    std::cout << "Number of words:  " << nwords_ << " ("
+              << nwords_ - knownWords << " new)" << std::endl;
+    std::cout << "Number of labels: " << nlabels_ << " ("
+              << size_ - known - (nwords_ - knownWords) << " new)" << std::endl;
+  }
+}
+
 void Dictionary::threshold(int64_t t, int64_t tl) {
   sort(words_.begin(), words_.end(), [](const entry& e1, const entry& e2) {
       if (e1.type != e2.type) return e1.type < e2.type;
@@ -253,9 +401,7 @@ void Dictionary::threshold(int64_t t, int64_t tl) {
   size_ = 0;
   nwords_ = 0;
   nlabels_ = 0;
-  for (int32_t i = 0; i < MAX_VOCAB_SIZE; i++) {
-    word2int_[i] = -1;
-  }
+  std::fill(word2int_.begin(), word2int_.end(), -1);
   for (auto it = words_.begin(); it != words_.end(); ++it) {
     int32_t h = find(it->word);
     word2int_[h] = size_++;
@@ -264,6 +410,60 @@ void Dictionary::threshold(int64_t t, int64_t tl) {
   }
 }
 
+// keep the words and buckets listed in idx (input row ids) and all labels.
+// idx is rewritten to the old row of every new row: the kept words in
+// order, then the kept buckets, which are looked up through pruneidx_.
+void Dictionary::prune(std::vector<int32_t>& idx) {
+  std::vector<int32_t> words, ngrams;
+  for (auto it = idx.cbegin(); it != idx.cend(); ++it) {
+    if (*it < nwords_) {
+      words.push_back(*it);
+    } else {
+      ngrams.push_back(*it);
+    }
+  }
+  std::sort(words.begin(), words.end());
+  std::sort(ngrams.begin(), ngrams.end());
+  // rows of an already pruned model map back to their original bucket
+  std::vector<int32_t> bucketOf;
+  for (const auto& p : pruneidx_) {
+    if (p.second >= int32_t(bucketOf.size())) bucketOf.resize(p.second + 1);
+    bucketOf[p.second] = p.first;
+  }
+  std::unordered_map<int32_t, int32_t> pruneidx;
+  for (size_t i = 0; i < ngrams.size(); i++) {
+    int32_t bucket = ngrams[i] - nwords_;
+    pruneidx[isPruned() ? bucketOf[bucket] : bucket] = i;
+  }
+  pruneidx_.swap(pruneidx);
+  pruneidx_size_ = pruneidx_.size();
+  idx = words;
+  idx.insert(idx.end(), ngrams.begin(), ngrams.end());
+
+  std::fill(word2int_.begin(), word2int_.end(), -1);
+  size_t j = 0;
+  for (int32_t i = 0; i < size_; i++) {
+    if (words_[i].type == entry_type::label ||
+        (j < words.size() && words[j] == i)) {
+      words_[j] = words_[i];
+      word2int_[find(words_[j].word)] = j;
+      j++;
+    }
+  }
+  nwords_ = words.size();
+  size_ = nwords_ + nlabels_;
+  words_.erase(words_.begin() + size_, words_.end());
+  for (auto& e : words_) {
+    e.subwords.clear();
+  }
+  initTableDiscard();
+  initNgrams();
+}
+
+bool Dictionary::isPruned() const {
+  return pruneidx_size_ >= 0;
+}
+
 void Dictionary::initTableDiscard() {
   pdiscard_.resize(size_);
   for (size_t i = 0; i < size_; i++) {
@@ -281,12 +481,18 @@ std::vector<int64_t> Dictionary::getCounts(entry_type type) const {
 }
 
 void Dictionary::addNgrams(std::vector<int32_t>& line, int32_t n) const {
+  addNgrams(line, n, args_->bucket);
+}
+
+// with a number of buckets other than the one of the args
+void Dictionary::addNgrams(std::vector<int32_t>& line, int32_t n,
+                           int32_t bucket) const {
   int32_t line_size = line.size();
   for (int32_t i = 0; i < line_size; i++) {
     uint64_t h = line[i];
     for (int32_t j = i + 1; j < line_size && j < i + n; j++) {
       h = h * 116049371 + line[j];
-      line.push_back(nwords_ + (h % args_->bucket));
+      pushHash(line, h % bucket);
     }
   }
 }
@@ -321,6 +527,34 @@ int32_t Dictionary::getLine(std::istream& in,
   return ntokens;
 }
 
+// getLine over the next line of [p, end), looking tokens up in place
+int32_t Dictionary::getLine(const char*& p, const char* end,
+                            std::vector<int32_t>& words,
+                            std::vector<int32_t>& labels,
+                            std::minstd_rand& rng) const {
+  std::uniform_real_distribution<> uniform(0, 1);
+  const char* token;
+  size_t len;
+  int32_t ntokens = 0;
+  words.clear();
+  labels.clear();
+  while (readWord(p, end, token, len)) {
+    if (len == EOS.size() && memcmp(token, EOS.data(), len) == 0) break;
+    int32_t wid = getId(token, len);
+    if (wid < 0) continue;
+    entry_type type = getType(wid);
+    ntokens++;
+    if (type == entry_type::word && !discard(wid, uniform(rng))) {
+      words.push_back(wid);
+    }
+    if (type == entry_type::label) {
+      labels.push_back(wid - nwords_);
+    }
+    if (words.size() > MAX_LINE_SIZE && args_->model != model_name::sup) break;
+  }
+  return ntokens;
+}
+
 std::string Dictionary::getLabel(int32_t lid) const {
   assert(lid >= 0);
   assert(lid < nlabels_);
@@ -339,17 +573,24 @@ void Dictionary::save(std::ostream& out) const {
     out.write((char*) &(e.count), sizeof(int64_t));
     out.write((char*) &(e.type), sizeof(entry_type));
   }
+  out.write((char*) &pruneidx_size_, sizeof(int64_t));
+  for (const auto& p : pruneidx_) {
+    out.write((char*) &(p.first), sizeof(int32_t));
+    out.write((char*) &(p.second), sizeof(int32_t));
+  }
 }
 
-void Dictionary::load(std::istream& in) {
+void Dictionary::load(std::istream& in, int32_t version) {
   words_.clear();
-  for (int32_t i = 0; i < MAX_VOCAB_SIZE; i++) {
-    word2int_[i] = -1;
-  }
+  pruneidx_.clear();
+  pruneidx_size_ = -1;
   in.read((char*) &size_, sizeof(int32_t));
   in.read((char*) &nwords_, sizeof(int32_t));
   in.read((char*) &nlabels_, sizeof(int32_t));
   in.read((char*) &ntokens_, sizeof(int64_t));
+  // a loaded vocabulary does not grow, so size the table to fit it
+  // rather than keeping the 30M slots needed while reading a corpus
+  word2int_.assign(std::min(int64_t(MAX_VOCAB_SIZE), int64_t(size_) * 2 + 1), -1);
   for (int32_t i = 0; i < size_; i++) {
     char c;
     entry e;
@@ -361,6 +602,15 @@ void Dictionary::load(std::istream& in) {
     words_.push_back(e);
     word2int_[find(e.word)] = i;
   }
+  if (version >= 3) {
+    in.read((char*) &pruneidx_size_, sizeof(int64_t));
+    for (int64_t i = 0; i < pruneidx_size_; i++) {
+      int32_t first, second;
+      in.read((char*) &first, sizeof(int32_t));
+      in.read((char*) &second, sizeof(int32_t));
+      pruneidx_[first] = second;
+    }
+  }
   initTableDiscard();
   initNgrams();
 }
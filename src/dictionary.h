@@ -16,6 +16,7 @@
 #include <ostream>
 #include <random>
 #include <memory>
+#include <unordered_map>
 
 #include "args.h"
 #include "real.h"
@@ -42,8 +43,10 @@ class Dictionary {
     static const int32_t MAX_LINE_SIZE = 1024;
 
     int32_t find(const std::string&) const;
+    int32_t find(const char*, size_t) const;
     void initTableDiscard();
     void initNgrams();
+    void pushHash(std::vector<int32_t>&, int32_t) const;
 
     std::shared_ptr<Args> args_;
     std::vector<int32_t> word2int_;
@@ -54,6 +57,9 @@ class Dictionary {
     int32_t nlabels_;
     int64_t ntokens_;
     std::string cur_label_;    
+    // bucket -> row of a pruned model; size -1 when nothing was pruned
+    std::unordered_map<int32_t, int32_t> pruneidx_;
+    int64_t pruneidx_size_;
 
   public:
     static const std::string EOS;
@@ -64,7 +70,9 @@ class Dictionary {
     int32_t nwords() const;
     int32_t nlabels() const;
     int64_t ntokens() const;
+    int64_t nlineTokens() const;
     int32_t getId(const std::string&) const;
+    int32_t getId(const char*, size_t) const;
     entry_type getType(int32_t) const;
     bool discard(int32_t, real) const;
     std::string getWord(int32_t) const;
@@ -72,17 +80,26 @@ class Dictionary {
     const std::vector<int32_t> getNgrams(const std::string&) const;
     void computeNgrams(const std::string&, std::vector<int32_t>&) const;
     uint32_t hash(const std::string& str) const;
+    uint32_t hash(const char*, size_t) const;
     void add(const std::string&);
+    void add(const char*, size_t);
     bool readWord(std::istream&, std::string&) const;
-    void readFromFile(std::istream&);
+    bool readWord(const char*&, const char*, const char*&, size_t&) const;
+    void readFromFile(const char*, const char*);
+    void update(const char*, const char*);
     std::string getLabel(int32_t) const;
     void save(std::ostream&) const;
-    void load(std::istream&);
+    void load(std::istream&, int32_t);
     std::vector<int64_t> getCounts(entry_type) const;
     void addNgrams(std::vector<int32_t>&, int32_t) const;
+    void addNgrams(std::vector<int32_t>&, int32_t, int32_t) const;
     int32_t getLine(std::istream&, std::vector<int32_t>&,
                     std::vector<int32_t>&, std::minstd_rand&) const;
+    int32_t getLine(const char*&, const char*, std::vector<int32_t>&,
+                    std::vector<int32_t>&, std::minstd_rand&) const;
     void threshold(int64_t, int64_t);
+    void prune(std::vector<int32_t>&);
+    bool isPruned() const;
 
     const std::vector<entry>& getWords() const;  
     std::vector<int32_t> getLabels(int32_t);  
@@ -11,6 +11,9 @@
 
 #include <fenv.h>
 #include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
 
 #include <iostream>
 #include <iomanip>
@@ -18,14 +21,40 @@
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <sstream>
 
 namespace fasttext {
 
-void FastText::getVector(Vector& vec, const std::string& word) {
+const int32_t FastText::BUDGET_EPOCHS;
+
+FastText::FastText() : quant_(false), nprobe_(0), resumed_(0) {}
+
+std::shared_ptr<const Args> FastText::getArgs() const {
+  return args_;
+}
+
+std::shared_ptr<const Dictionary> FastText::getDictionary() const {
+  return dict_;
+}
+
+void FastText::addInputRow(Vector& vec, int32_t i) const {
+  if (quant_) {
+    qinput_->addToVector(vec, i);
+  } else {
+    vec.addRow(*input_, i);
+  }
+}
+
+void FastText::getVector(Vector& vec, const std::string& word) const {
   const std::vector<int32_t>& ngrams = dict_->getNgrams(word);
   vec.zero();
   for (auto it = ngrams.begin(); it != ngrams.end(); ++it) {
-    vec.addRow(*input_, *it);
+    addInputRow(vec, *it);
   }
   if (ngrams.size() > 0) {
     vec.mul(1.0 / ngrams.size());
@@ -33,34 +62,121 @@ void FastText::getVector(Vector& vec, const std::string& word) {
 }
 
 void FastText::saveVectors() {
-  std::ofstream ofs(args_->output + ".vec");
-  if (!ofs.is_open()) {
-    std::cout << "Error opening file for saving vectors." << std::endl;
-    exit(EXIT_FAILURE);
-  }
-  ofs << dict_->nwords() << " " << args_->dim << std::endl;
-  Vector vec(args_->dim);
+  std::vector<std::string> words(dict_->nwords());
   for (int32_t i = 0; i < dict_->nwords(); i++) {
-    std::string word = dict_->getWord(i);
-    getVector(vec, word);
-    ofs << word << " " << vec << std::endl;
+    words[i] = dict_->getWord(i);
+  }
+  auto row = [&](int64_t i, Vector& vec) {
+    const std::vector<int32_t>& ngrams = dict_->getNgrams(int32_t(i));
+    vec.zero();
+    for (auto it = ngrams.begin(); it != ngrams.end(); ++it) {
+      addInputRow(vec, *it);
+    }
+    if (ngrams.size() > 0) {
+      vec.mul(1.0 / ngrams.size());
+    }
+  };
+  if (args_->vectorFormat != vector_format::bvec) {
+    vectors::saveText(args_->output + ".vec", words, args_->dim, row, args_->thread);
+  }
+  if (args_->vectorFormat != vector_format::vec) {
+    vectors::saveBinary(args_->output + ".bvec", words, args_->dim, row, args_->thread);
   }
-  ofs.close();
 }
 
 void FastText::saveModel() {
-  std::ofstream ofs(args_->output + ".bin", std::ofstream::binary);
+  std::string ext = quant_ ? ".ftz" : ".bin";
+  std::ofstream ofs(args_->output + ext, std::ofstream::binary);
   if (!ofs.is_open()) {
     std::cerr << "Model file cannot be opened for saving!" << std::endl;
     exit(EXIT_FAILURE);
   }
-  args_->save(ofs);
-  dict_->save(ofs);
-  input_->save(ofs);
-  output_->save(ofs);
+  saveModel(ofs);
   ofs.close();
 }
 
+void FastText::saveModel(std::ostream& out) {
+  const int32_t magic = FASTTEXT_FILEFORMAT_MAGIC_INT32;
+  const int32_t version = FASTTEXT_VERSION;
+  out.write((char*) &magic, sizeof(int32_t));
+  out.write((char*) &version, sizeof(int32_t));
+  args_->save(out);
+  dict_->save(out);
+  out.write((char*) &quant_, sizeof(bool));
+  if (quant_) {
+    qinput_->save(out);
+  } else {
+    input_->save(out);
+  }
+  bool qout = qoutput_ != nullptr;
+  out.write((char*) &qout, sizeof(bool));
+  if (qout) {
+    qoutput_->save(out);
+  } else {
+    output_->save(out);
+  }
+}
+
+// Runs beside the training threads without stopping them: rows are read
+// while they change, as hogwild reads them anyway. The progress is taken
+// first, so the matrices hold at least the training it claims. The file
+// is written aside and renamed, a crash never leaves half a checkpoint.
+void FastText::saveCheckpoint() {
+  std::string filename = args_->output + ".ckpt";
+  std::ofstream ofs(filename + ".tmp", std::ofstream::binary);
+  if (!ofs.is_open()) {
+    std::cerr << "Checkpoint file cannot be opened for saving!" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  int64_t tokens = tokenCount->total();
+  std::stringstream progress;
+  scheduler_->save(progress);
+  saveModel(ofs);
+  ofs.write((char*) &tokens, sizeof(int64_t));
+  ofs << progress.rdbuf();
+  ofs.close();
+  if (!ofs || rename((filename + ".tmp").c_str(), filename.c_str()) != 0) {
+    std::cerr << "Checkpoint file cannot be saved!" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+}
+
+// the saved args replace the ones of the command line they cover
+void FastText::loadCheckpoint(int32_t readers) {
+  std::ifstream ifs(args_->output + ".ckpt", std::ifstream::binary);
+  if (!ifs.is_open()) {
+    std::cerr << "Checkpoint file cannot be opened for loading!" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  int32_t magic, version;
+  ifs.read((char*) &magic, sizeof(int32_t));
+  ifs.read((char*) &version, sizeof(int32_t));
+  if (magic != FASTTEXT_FILEFORMAT_MAGIC_INT32 || version != FASTTEXT_VERSION) {
+    std::cerr << "Checkpoint file is not valid!" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  bool quant;
+  args_->load(ifs, version);
+  dict_->load(ifs, version);
+  input_ = std::make_shared<Matrix>(args_->storage);
+  ifs.read((char*) &quant, sizeof(bool));
+  if (quant) {
+    std::cerr << "Checkpoint file holds a quantized model!" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  input_->load(ifs);
+  output_ = std::make_shared<Matrix>(args_->storage);
+  ifs.read((char*) &quant, sizeof(bool));
+  if (quant) {
+    std::cerr << "Checkpoint file holds a quantized model!" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  output_->load(ifs);
+  ifs.read((char*) &resumed_, sizeof(int64_t));
+  scheduler_ = std::make_shared<ChunkScheduler>();
+  scheduler_->load(ifs, corpus_->size(), readers);
+}
+
 void FastText::loadModel(const std::string& filename) {
   std::ifstream ifs(filename, std::ifstream::binary);
   if (!ifs.is_open()) {
@@ -72,15 +188,48 @@ void FastText::loadModel(const std::string& filename) {
 }
 
 void FastText::loadModel(std::istream& in) {
+  // models saved before the file format was versioned start with the args
+  int32_t magic, version = 0;
+  in.read((char*) &magic, sizeof(int32_t));
+  if (magic == FASTTEXT_FILEFORMAT_MAGIC_INT32) {
+    in.read((char*) &version, sizeof(int32_t));
+  } else {
+    in.seekg(-int64_t(sizeof(int32_t)), std::ios::cur);
+  }
+  if (version > FASTTEXT_VERSION) {
+    std::cerr << "Model file was saved by a newer version!" << std::endl;
+    exit(EXIT_FAILURE);
+  }
   args_ = std::make_shared<Args>();
   dict_ = std::make_shared<Dictionary>(args_);
-  input_ = std::make_shared<Matrix>();
-  output_ = std::make_shared<Matrix>();
-  args_->load(in);
-  dict_->load(in);
-  input_->load(in);
-  output_->load(in);
+  args_->load(in, version);
+  input_ = std::make_shared<Matrix>(args_->storage);
+  output_ = std::make_shared<Matrix>(args_->storage);
+  dict_->load(in, version);
+  bool qout = false;
+  quant_ = false;
+  qinput_.reset();
+  qoutput_.reset();
+  if (version >= 2) {
+    in.read((char*) &quant_, sizeof(bool));
+  }
+  if (quant_) {
+    qinput_ = std::make_shared<QMatrix>();
+    qinput_->load(in);
+  } else {
+    input_->load(in);
+  }
+  if (version >= 2) {
+    in.read((char*) &qout, sizeof(bool));
+  }
+  if (qout) {
+    qoutput_ = std::make_shared<QMatrix>();
+    qoutput_->load(in);
+  } else {
+    output_->load(in);
+  }
   model_ = std::make_shared<Model>(input_, output_, args_, 0);
+  model_->setQuantizePointer(qinput_, qoutput_);
   if (args_->model == model_name::sup) {
     model_->setTargetCounts(dict_->getCounts(entry_type::label));
   } else {
@@ -90,7 +239,7 @@ void FastText::loadModel(std::istream& in) {
 
 void FastText::printInfo(real progress, real loss) {
   real t = real(clock() - start) / CLOCKS_PER_SEC;
-  real wst = real(tokenCount) / t;
+  real wst = real(tokenCount->total() - resumed_) / t;
   real lr = args_->lr * (1.0 - progress);
   int eta = int(t / progress * (1 - progress) / args_->thread);
   int etah = eta / 3600;
@@ -104,6 +253,13 @@ void FastText::printInfo(real progress, real loss) {
   std::cout << std::flush;
 }
 
+// share of the -timeBudget training window gone by
+real FastText::timeProgress() const {
+  double window = std::chrono::duration<double>(trainEnd_ - trainStart_).count();
+  double done = std::chrono::duration<double>(steady_clock::now() - trainStart_).count();
+  return std::min(real(done / window), real(1.0));
+}
+
 void FastText::supervised(Model& model, real lr,
                           const std::vector<int32_t>& line,
                           const std::vector<int32_t>& labels) {
@@ -167,13 +323,15 @@ void FastText::test(std::istream& in, int32_t k) {
   int32_t nexamples = 0, nlabels = 0;
   double precision = 0.0;
   std::vector<int32_t> line, labels;
+  Vector hidden(args_->dim);
+  Vector output(dict_->nlabels());
 
   while (in.peek() != EOF) {
     dict_->getLine(in, line, labels, model_->rng);
     dict_->addNgrams(line, args_->wordNgrams);
     if (labels.size() > 0 && line.size() > 0) {
       std::vector<std::pair<real, int32_t>> modelPredictions;
-      model_->predict(line, k, modelPredictions);
+      model_->predict(line, k, modelPredictions, hidden, output);
       for (auto it = modelPredictions.cbegin(); it != modelPredictions.cend(); it++) {
         if (std::find(labels.begin(), labels.end(), it->second) != labels.end()) {
           precision += 1.0;
@@ -189,16 +347,139 @@ void FastText::test(std::istream& in, int32_t k) {
   std::cout << "Number of examples: " << nexamples << std::endl;
 }
 
+// runs the model over pre-tokenized examples; returns the number of
+// correct labels among the top k and adds the elapsed time to seconds
+static double evaluate(const Model& model, int32_t k, int32_t dim, int32_t nlabels,
+                       const std::vector<std::vector<int32_t>>& lines,
+                       const std::vector<std::vector<int32_t>>& labels,
+                       double& seconds) {
+  double precision = 0.0;
+  Vector hidden(dim);
+  Vector output(nlabels);
+  std::vector<std::pair<real, int32_t>> modelPredictions;
+  auto begin = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < lines.size(); i++) {
+    modelPredictions.clear();
+    model.predict(lines[i], k, modelPredictions, hidden, output);
+    for (auto it = modelPredictions.cbegin(); it != modelPredictions.cend(); it++) {
+      if (std::find(labels[i].begin(), labels[i].end(), it->second) != labels[i].end()) {
+        precision += 1.0;
+      }
+    }
+  }
+  seconds += std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - begin).count();
+  return precision;
+}
+
+// the labeled lines of the -validation file, without their ngrams
+void FastText::readValidation(std::vector<std::vector<int32_t>>& lines,
+                              std::vector<std::vector<int32_t>>& labels) {
+  if (args_->model != model_name::sup) {
+    std::cerr << "Validation needs a supervised model!" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  std::ifstream ifs(args_->validation);
+  if (!ifs.is_open()) {
+    std::cerr << "Validation file cannot be opened!" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  std::minstd_rand rng(args_->seed);
+  std::vector<int32_t> line, label;
+  while (ifs.peek() != EOF) {
+    dict_->getLine(ifs, line, label, rng);
+    if (label.size() > 0 && line.size() > 0) {
+      lines.push_back(line);
+      labels.push_back(label);
+    }
+  }
+  if (lines.empty()) {
+    std::cerr << "No labeled examples in the validation data!" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+}
+
+// compares the model against an int8 copy of its matrices on the same
+// examples: accuracy, latency and memory side by side
+void FastText::testInt8(std::istream& in, int32_t k) {
+  if (quant_ || args_->model != model_name::sup) {
+    std::cerr << "Int8 inference needs a supervised model that is not quantized!"
+              << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  std::vector<std::vector<int32_t>> lines, labels;
+  std::vector<int32_t> line, label;
+  int64_t nlabels = 0;
+  while (in.peek() != EOF) {
+    dict_->getLine(in, line, label, model_->rng);
+    dict_->addNgrams(line, args_->wordNgrams);
+    if (label.size() > 0 && line.size() > 0) {
+      lines.push_back(line);
+      labels.push_back(label);
+      nlabels += label.size();
+    }
+  }
+  if (lines.empty()) {
+    std::cerr << "No labeled examples in the test data!" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  auto iinput = std::make_shared<Int8Matrix>(*input_);
+  auto ioutput = std::make_shared<Int8Matrix>(*output_);
+  Model int8(input_, output_, args_, 0);
+  int8.setInt8Pointer(iinput, ioutput);
+  int8.setTargetCounts(dict_->getCounts(entry_type::label));
+
+  double fpTime = 0.0, i8Time = 0.0;
+  double fp = evaluate(*model_, k, args_->dim, dict_->nlabels(), lines, labels, fpTime);
+  double i8 = evaluate(int8, k, args_->dim, dict_->nlabels(), lines, labels, i8Time);
+
+  int64_t n = lines.size();
+  double fpBytes = input_->bytes() + output_->bytes();
+  double i8Bytes = iinput->bytes() + ioutput->bytes();
+  std::cout << "Int8 kernel: " << Int8Matrix::kernel() << std::endl;
+  std::cout << "Number of examples: " << n << std::endl;
+  std::cout << std::fixed << std::setprecision(3);
+  std::cout << "      " << std::setw(8) << ("P@" + std::to_string(k))
+            << std::setw(8) << ("R@" + std::to_string(k))
+            << std::setw(14) << "us/example" << std::setw(10) << "MB" << std::endl;
+  std::cout << "fp32  " << std::setw(8) << fp / (k * n) << std::setw(8) << fp / nlabels
+            << std::setw(14) << 1e6 * fpTime / n
+            << std::setw(10) << fpBytes / (1 << 20) << std::endl;
+  std::cout << "int8  " << std::setw(8) << i8 / (k * n) << std::setw(8) << i8 / nlabels
+            << std::setw(14) << 1e6 * i8Time / n
+            << std::setw(10) << i8Bytes / (1 << 20) << std::endl;
+}
+
 void FastText::predict(std::istream& in, int32_t k,
                        std::vector<std::pair<real,std::string>>& predictions) const {
+  Vector hidden(args_->dim);
+  Vector output(dict_->nlabels());
+  std::minstd_rand rng;
+  predict(in, k, predictions, hidden, output, rng);
+}
+
+// Buffers and random state come from the caller, so threads that each
+// bring their own can predict with the same model at once. Labels are
+// given by id, best first.
+void FastText::predict(std::istream& in, int32_t k,
+                       std::vector<std::pair<real,int32_t>>& predictions,
+                       Vector& hidden, Vector& output,
+                       std::minstd_rand& rng) const {
   std::vector<int32_t> words, labels;
-  dict_->getLine(in, words, labels, model_->rng);
+  predictions.clear();
+  dict_->getLine(in, words, labels, rng);
   dict_->addNgrams(words, args_->wordNgrams);
   if (words.empty()) return;
-  Vector hidden(args_->dim);
-  Vector output(dict_->nlabels());
+  model_->predict(words, k, predictions, hidden, output);
+}
+
+void FastText::predict(std::istream& in, int32_t k,
+                       std::vector<std::pair<real,std::string>>& predictions,
+                       Vector& hidden, Vector& output,
+                       std::minstd_rand& rng) const {
   std::vector<std::pair<real,int32_t>> modelPredictions;
-  model_->predict(words, k, modelPredictions, hidden, output);
+  predict(in, k, modelPredictions, hidden, output, rng);
   predictions.clear();
   for (auto it = modelPredictions.cbegin(); it != modelPredictions.cend(); it++) {
     predictions.push_back(std::make_pair(it->first, dict_->getLabel(it->second)));
@@ -207,8 +488,10 @@ void FastText::predict(std::istream& in, int32_t k,
 
 void FastText::predict(std::istream& in, int32_t k, bool print_prob) {
   std::vector<std::pair<real,std::string>> predictions;
+  Vector hidden(args_->dim);
+  Vector output(dict_->nlabels());
   while (in.peek() != EOF) {
-    predict(in, k, predictions);
+    predict(in, k, predictions, hidden, output, model_->rng);
     if (predictions.empty()) {
       std::cout << "n/a" << std::endl;
       continue;
@@ -235,6 +518,232 @@ void FastText::wordVectors() {
   }
 }
 
+// unit-length vectors of the whole vocabulary, one padded row per word
+void FastText::precomputeWordVectors(Matrix& wordVectors) const {
+  wordVectors = Matrix(dict_->nwords(), args_->dim);
+  int32_t threads = std::max(1u, std::thread::hardware_concurrency());
+  int64_t n = dict_->nwords();
+  auto worker = [&](int64_t begin, int64_t end) {
+    Vector vec(args_->dim);
+    for (int64_t i = begin; i < end; i++) {
+      getVector(vec, dict_->getWord(i));
+      real norm = 0.0;
+      for (int64_t j = 0; j < args_->dim; j++) {
+        norm += vec[j] * vec[j];
+      }
+      if (norm > 0) {
+        vec.mul(1.0 / std::sqrt(norm));
+      }
+      wordVectors.setRow(i, vec.data_);
+    }
+  };
+  std::vector<std::thread> workers;
+  for (int32_t t = 1; t < threads; t++) {
+    workers.push_back(std::thread(worker, t * n / threads, (t + 1) * n / threads));
+  }
+  worker(0, n / threads);
+  for (auto& w : workers) {
+    w.join();
+  }
+}
+
+// k most similar words to query by cosine similarity, best first. Rows
+// are scored a block at a time and only scores beating the current k-th
+// best go through the heap.
+void FastText::findNN(const Matrix& wordVectors, const Vector& query, int32_t k,
+                      const std::vector<std::string>& banned,
+                      std::vector<std::pair<real, std::string>>& results) const {
+  const int64_t BLOCK = 256;
+  results.clear();
+  real norm = 0.0;
+  for (int64_t j = 0; j < query.m_; j++) {
+    norm += query[j] * query[j];
+  }
+  if (norm == 0 || k <= 0) return;
+  Vector q(query.m_);
+  for (int64_t j = 0; j < query.m_; j++) {
+    q[j] = query[j] / std::sqrt(norm);
+  }
+  std::vector<int32_t> bannedIds;
+  for (auto& w : banned) {
+    bannedIds.push_back(dict_->getId(w));
+  }
+
+  typedef std::pair<real, int32_t> scored;
+  std::priority_queue<scored, std::vector<scored>, std::greater<scored>> heap;
+  real scores[BLOCK];
+  int64_t stride = wordVectors.stride_;
+  for (int64_t b = 0; b < wordVectors.m_; b += BLOCK) {
+    int64_t e = std::min(b + BLOCK, wordVectors.m_);
+    for (int64_t i = b; i < e; i++) {
+      scores[i - b] = utils::dotPadded(wordVectors.data_ + i * stride, q.data_, stride);
+    }
+    for (int64_t i = b; i < e; i++) {
+      real s = scores[i - b];
+      if (int32_t(heap.size()) == k && s <= heap.top().first) continue;
+      if (std::find(bannedIds.begin(), bannedIds.end(), i) != bannedIds.end()) continue;
+      heap.push(std::make_pair(s, int32_t(i)));
+      if (int32_t(heap.size()) > k) heap.pop();
+    }
+  }
+  while (!heap.empty()) {
+    results.push_back(std::make_pair(heap.top().first, dict_->getWord(heap.top().second)));
+    heap.pop();
+  }
+  std::reverse(results.begin(), results.end());
+}
+
+// same as findNN, from the lists of the word index closest to the query
+void FastText::findNNIndexed(const Vector& query, int32_t k,
+                             const std::vector<std::string>& banned,
+                             std::vector<std::pair<real, std::string>>& results) const {
+  results.clear();
+  real norm = 0.0;
+  for (int64_t j = 0; j < query.m_; j++) {
+    norm += query[j] * query[j];
+  }
+  if (norm == 0 || k <= 0) return;
+  Vector q(query.m_);
+  for (int64_t j = 0; j < query.m_; j++) {
+    q[j] = query[j] / std::sqrt(norm);
+  }
+  std::vector<std::pair<real, int32_t>> found;
+  wordIndex_->search(q.data_, k + banned.size(), nprobe_, found);
+  for (auto it = found.cbegin(); it != found.cend(); it++) {
+    const std::string& word = dict_->getWord(it->second);
+    if (int32_t(results.size()) == k) break;
+    if (std::find(banned.begin(), banned.end(), word) != banned.end()) continue;
+    results.push_back(std::make_pair(it->first, word));
+  }
+}
+
+// Queries are read from stdin, one per line. From a terminal they are
+// answered one by one; piped in, they are answered in batches spread over
+// all cores, in input order. build turns a query line into the vector to
+// search for and the words to leave out of the answer.
+static void runQueries(const std::string& prompt,
+                       std::function<bool(const std::string&, Vector&,
+                                          std::vector<std::string>&)> build,
+                       std::function<void(const Vector&, const std::vector<std::string>&,
+                                          std::vector<std::pair<real, std::string>>&)> search,
+                       int64_t dim) {
+  const int64_t BATCH = 4096;
+  bool interactive = isatty(fileno(stdin));
+  int32_t threads = interactive ? 1 : std::max(1u, std::thread::hardware_concurrency());
+  std::vector<std::string> queries;
+  std::vector<std::vector<std::pair<real, std::string>>> answers;
+  std::vector<char> valid;
+  std::string line;
+  while (true) {
+    queries.clear();
+    if (interactive) std::cout << prompt << std::endl;
+    while (queries.size() < (interactive ? 1 : BATCH) && std::getline(std::cin, line)) {
+      if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+      queries.push_back(line);
+    }
+    if (queries.empty()) break;
+    int64_t n = queries.size();
+    answers.assign(n, std::vector<std::pair<real, std::string>>());
+    valid.assign(n, false);
+    std::vector<std::thread> workers;
+    auto worker = [&](int64_t begin, int64_t end) {
+      Vector query(dim);
+      std::vector<std::string> banned;
+      for (int64_t i = begin; i < end; i++) {
+        banned.clear();
+        if (build(queries[i], query, banned)) {
+          valid[i] = true;
+          search(query, banned, answers[i]);
+        }
+      }
+    };
+    int32_t t = std::min<int64_t>(threads, n);
+    for (int32_t w = 1; w < t; w++) {
+      workers.push_back(std::thread(worker, w * n / t, (w + 1) * n / t));
+    }
+    worker(0, n / t);
+    for (auto& w : workers) {
+      w.join();
+    }
+    for (int64_t i = 0; i < n; i++) {
+      if (!interactive) std::cout << "Query: " << queries[i] << std::endl;
+      if (!valid[i]) {
+        std::cout << "n/a" << std::endl;
+      }
+      for (auto& a : answers[i]) {
+        std::cout << a.second << " " << a.first << std::endl;
+      }
+      std::cout << std::endl;
+    }
+  }
+}
+
+void FastText::nn(int32_t k) {
+  Matrix wordVectors;
+  if (!wordIndex_) {
+    precomputeWordVectors(wordVectors);
+  }
+  auto build = [&](const std::string& line, Vector& query,
+                   std::vector<std::string>& banned) {
+    std::istringstream iss(line);
+    std::string word;
+    iss >> word;
+    getVector(query, word);
+    banned.push_back(word);
+    return true;
+  };
+  auto search = [&](const Vector& query, const std::vector<std::string>& banned,
+                    std::vector<std::pair<real, std::string>>& results) {
+    if (wordIndex_) {
+      findNNIndexed(query, k, banned, results);
+    } else {
+      findNN(wordVectors, query, k, banned, results);
+    }
+  };
+  runQueries("Query word?", build, search, args_->dim);
+}
+
+// "A B C" looks for the words closest to A - B + C
+void FastText::analogies(int32_t k) {
+  Matrix wordVectors;
+  if (!wordIndex_) {
+    precomputeWordVectors(wordVectors);
+  }
+  auto build = [&](const std::string& line, Vector& query,
+                   std::vector<std::string>& banned) {
+    std::istringstream iss(line);
+    std::string words[3];
+    if (!(iss >> words[0] >> words[1] >> words[2])) {
+      return false;
+    }
+    Vector buffer(args_->dim);
+    query.zero();
+    const real signs[3] = {1.0, -1.0, 1.0};
+    for (int32_t w = 0; w < 3; w++) {
+      getVector(buffer, words[w]);
+      real norm = 0.0;
+      for (int64_t j = 0; j < args_->dim; j++) {
+        norm += buffer[j] * buffer[j];
+      }
+      real a = norm > 0 ? signs[w] / std::sqrt(norm) : 0.0;
+      for (int64_t j = 0; j < args_->dim; j++) {
+        query[j] += a * buffer[j];
+      }
+      banned.push_back(words[w]);
+    }
+    return true;
+  };
+  auto search = [&](const Vector& query, const std::vector<std::string>& banned,
+                    std::vector<std::pair<real, std::string>>& results) {
+    if (wordIndex_) {
+      findNNIndexed(query, k, banned, results);
+    } else {
+      findNN(wordVectors, query, k, banned, results);
+    }
+  };
+  runQueries("Query triplet (A - B + C)?", build, search, args_->dim);
+}
+
 void FastText::textVectors() {
   std::vector<int32_t> line, labels;
   Vector vec(args_->dim);
@@ -243,7 +752,7 @@ void FastText::textVectors() {
     dict_->addNgrams(line, args_->wordNgrams);
     vec.zero();
     for (auto it = line.cbegin(); it != line.cend(); ++it) {
-      vec.addRow(*input_, *it);
+      addInputRow(vec, *it);
     }
     if (!line.empty()) {
       vec.mul(1.0 / line.size());
@@ -260,26 +769,69 @@ void FastText::printVectors() {
   }
 }
 
+// must run before the matrix is first written
+void FastText::placeMatrix(Matrix& mat) {
+  if (args_->numa == numa_policy::interleave) {
+    numa::interleave(mat.ptr(), mat.bytes());
+  } else if (args_->numa == numa_policy::partition) {
+    numa::partition(mat.ptr(), mat.bytes());
+  }
+}
+
+// give every node its own copy of the output matrix (replica 0 is output_)
+void FastText::replicateOutput() {
+  outputs_.clear();
+  outputs_.push_back(output_);
+  if (args_->replicaSync <= 0 || numa::nodes() < 2 || args_->workers > 1) return;
+  for (int32_t i = 1; i < numa::nodes(); i++) {
+    auto replica = std::make_shared<Matrix>(output_->m_, output_->n_, output_->storage_);
+    numa::bind(replica->ptr(), replica->bytes(), i);
+    memcpy(replica->ptr(), output_->ptr(), output_->bytes());
+    outputs_.push_back(replica);
+  }
+}
+
+void FastText::averageReplicas() {
+  Vector row(output_->n_), sum(output_->n_);
+  real scale = 1.0 / outputs_.size();
+  for (int64_t i = 0; i < output_->m_; i++) {
+    sum.zero();
+    for (auto& replica : outputs_) {
+      sum.addRow(*replica, i);
+    }
+    sum.mul(scale);
+    for (auto& replica : outputs_) {
+      replica->setRow(i, sum.data_);
+    }
+  }
+}
+
 void FastText::trainThread(int32_t threadId) {
-  std::ifstream ifs(args_->input);
-  utils::seek(ifs, threadId * utils::size(ifs) / args_->thread);
+  int32_t node = numa::nodeOf(threadId, args_->thread);
+  if (args_->numa != numa_policy::none) {
+    numa::pinThread(node);
+  }
 
-  Model model(input_, output_, args_, threadId);
+  auto output = outputs_.size() > 1 ? outputs_[node] : output_;
+  Model model(input_, output, args_, args_->seed + threadId);
   if (args_->model == model_name::sup) {
     model.setTargetCounts(dict_->getCounts(entry_type::label));
   } else {
     model.setTargetCounts(dict_->getCounts(entry_type::word));
   }
 
-  const int64_t ntokens = dict_->ntokens();
+  const int64_t ntokens = dict_->nlineTokens() * scheduler_->share();
   int64_t localTokenCount = 0;
+  int64_t nextSync = args_->replicaSync;
+  int64_t nextRound = args_->syncRate;
+  real progress = std::min(real(tokenCount->total()) / (args_->epoch * ntokens), real(1.0));
+  bool expired = false;
   std::vector<int32_t> line, labels;
-  while (tokenCount < args_->epoch * ntokens) {
-    real progress = real(tokenCount) / (args_->epoch * ntokens);
+  // trains on one tokenized line, ngrams included
+  auto step = [&](int32_t n) {
     real lr = args_->lr * (1.0 - progress);
-    localTokenCount += dict_->getLine(ifs, line, labels, model.rng);
+    localTokenCount += n;
     if (args_->model == model_name::sup) {
-      dict_->addNgrams(line, args_->wordNgrams);
       supervised(model, lr, line, labels);
     } else if (args_->model == model_name::cbow) {
       cbow(model, lr, line);
@@ -287,134 +839,720 @@ void FastText::trainThread(int32_t threadId) {
       skipgram(model, lr, line);
     } else if (args_->model == model_name::pwv) { // updated
       pwv(model, lr, line);
-    }     
+    }
     if (localTokenCount > args_->lrUpdateRate) {
-      tokenCount += localTokenCount;
+      tokenCount->add(threadId, localTokenCount);
       localTokenCount = 0;
+      // total() sums every thread's slot, so it is read once per flush
+      int64_t total = tokenCount->total();
+      if (args_->timeBudget > 0) {
+        progress = timeProgress();
+        expired = progress >= 1.0;
+      } else {
+        progress = std::min(real(total) / (args_->epoch * ntokens), real(1.0));
+      }
+      if (threadId == 0 && outputs_.size() > 1 && total >= nextSync) {
+        averageReplicas();
+        nextSync = total + args_->replicaSync;
+      }
+      if (threadId == 0 && sync_ && total >= nextRound) {
+        sync_->sync({input_, output_}, false);
+        nextRound = total + args_->syncRate;
+      }
       if (threadId == 0 && args_->verbose > 1) {
         printInfo(progress, model.getLoss());
       }
     }
+  };
+  if (pipeline_) {
+    LineBatch* batch;
+    // once time is up, batches still coming are given back untrained
+    while ((batch = pipeline_->next()) != nullptr) {
+      for (int64_t i = 0; i < batch->size() && !expired; i++) {
+        batch->get(i, line, labels);
+        step(batch->ntokens[i]);
+      }
+      pipeline_->release(batch);
+      if (expired) scheduler_->stop();
+    }
+  } else {
+    Chunk chunk;
+    while (!expired && scheduler_->next(threadId, chunk)) {
+      const char* p = corpus_->begin() + chunk.begin;
+      const char* end = corpus_->begin() + std::min(chunk.end, corpus_->size());
+      while (p < end && !expired) {
+        int32_t n = dict_->getLine(p, end, line, labels, model.rng);
+        if (args_->model == model_name::sup) {
+          dict_->addNgrams(line, args_->wordNgrams);
+        }
+        step(n);
+      }
+    }
   }
+  tokenCount->add(threadId, localTokenCount);
   if (threadId == 0 && args_->verbose > 0) {
     printInfo(1.0, model.getLoss());
     std::cout << std::endl;
   }
-  ifs.close();
 }
 
-void FastText::loadVectors(std::string filename) {
-  std::ifstream in(filename);
-  std::vector<std::string> words;
-  std::shared_ptr<Matrix> mat; // temp. matrix for pretrained vectors
-  int64_t n, dim;
-  if (!in.is_open()) {
-    std::cerr << "Pretrained vectors file cannot be opened!" << std::endl;
-    exit(EXIT_FAILURE);
+// tokenizes chunks for the training threads when -pipeline is set: lines
+// come out subsampled and with their ngrams, in batches
+void FastText::tokenizeThread(int32_t threadId) {
+  std::minstd_rand rng(args_->seed + args_->thread + threadId);
+  std::vector<int32_t> line, labels;
+  LineBatch* batch = pipeline_->acquire();
+  Chunk chunk;
+  while (scheduler_->next(threadId, chunk)) {
+    const char* p = corpus_->begin() + chunk.begin;
+    const char* end = corpus_->begin() + std::min(chunk.end, corpus_->size());
+    while (p < end) {
+      int32_t n = dict_->getLine(p, end, line, labels, rng);
+      if (args_->model == model_name::sup) {
+        dict_->addNgrams(line, args_->wordNgrams);
+      }
+      batch->add(line, labels, n);
+      if (int64_t(batch->words.size()) >= Pipeline::BATCH_WORDS) {
+        pipeline_->publish(batch);
+        batch = pipeline_->acquire();
+      }
+    }
+  }
+  if (batch->size() > 0) {
+    pipeline_->publish(batch);
+  } else {
+    pipeline_->release(batch);
   }
-  in >> n >> dim;
-  if (dim != args_->dim) {
+  pipeline_->done();
+}
+
+// text (.vec) or binary (.bvec) vectors; binary rows are used straight
+// from a mapping of the file
+void FastText::loadVectors(std::string filename) {
+  vectors::Table table;
+  table.load(filename, args_->thread);
+  if (table.dim != args_->dim) {
     std::cerr << "Dimension of pretrained vectors does not match -dim option"
               << std::endl;
     exit(EXIT_FAILURE);
   }
-  mat = std::make_shared<Matrix>(n, dim);
-  for (size_t i = 0; i < n; i++) {
-    std::string word;
-    in >> word;
-    words.push_back(word);
-    dict_->add(word);
-    for (size_t j = 0; j < dim; j++) {
-      in >> mat->data_[i * dim + j];
-    }
+  int64_t n = table.size();
+  const std::vector<std::string>& words = table.words;
+  for (int64_t i = 0; i < n; i++) {
+    dict_->add(words[i]);
   }
-  in.close();
 
   dict_->threshold(1, 0);
-  input_ = std::make_shared<Matrix>(dict_->nwords()+args_->bucket, args_->dim);
-  input_->uniform(1.0 / args_->dim);
+  input_ = std::make_shared<Matrix>(dict_->nwords()+args_->bucket, args_->dim, args_->storage);
+  if (args_->bucket > 0) {
+    input_->deferUniform(dict_->nwords(), 1.0 / args_->dim, args_->seed);
+  }
+  placeMatrix(*input_);
+  input_->uniform(1.0 / args_->dim, args_->seed, args_->thread);
 
-  for (size_t i = 0; i < n; i++) {
+  for (int64_t i = 0; i < n; i++) {
     int32_t idx = dict_->getId(words[i]);
     if (idx < 0 || idx >= dict_->nwords()) continue;
-    for (size_t j = 0; j < dim; j++) {
-      input_->data_[idx * dim + j] = mat->data_[i * dim + j];
-    }
+    input_->setRow(idx, table.row(i));
   }
 }
 
-void FastText::train(std::shared_ptr<Args> args) {
-  args_ = args;
-  dict_ = std::make_shared<Dictionary>(args_);
-  if (args_->input == "-") {
-    // manage expectations
-    std::cerr << "Cannot use stdin for training!" << std::endl;
+void FastText::quantize(std::shared_ptr<Args> qargs) {
+  loadModel(qargs->output + ".bin");
+  if (quant_) {
+    std::cerr << "Model is already quantized!" << std::endl;
     exit(EXIT_FAILURE);
   }
-  std::ifstream ifs(args_->input);
+  args_->output = qargs->output;
+  int64_t before = input_->bytes() + output_->bytes();
+  qinput_ = std::make_shared<QMatrix>(*input_, qargs->dsub, qargs->qnorm);
+  input_ = std::make_shared<Matrix>(args_->storage);
+  int64_t after = qinput_->bytes() + output_->bytes();
+  if (qargs->qout && output_->m_ < 256) {
+    std::cerr << "Output matrix too small to quantize, keeping it." << std::endl;
+  } else if (qargs->qout) {
+    qoutput_ = std::make_shared<QMatrix>(*output_, 2, qargs->qnorm);
+    output_ = std::make_shared<Matrix>(args_->storage);
+    after = qinput_->bytes() + qoutput_->bytes();
+  }
+  quant_ = true;
+  model_ = std::make_shared<Model>(input_, output_, args_, 0);
+  model_->setQuantizePointer(qinput_, qoutput_);
+  if (qargs->verbose > 0) {
+    std::cout << "Matrices: " << before / 1000000.0 << "MB -> "
+              << after / 1000000.0 << "MB" << std::endl;
+  }
+  saveModel();
+}
+
+// keep the cutoff input rows that matter most: by norm, or by how much
+// they move the scores of the true labels of a validation file
+void FastText::prune(std::shared_ptr<Args> qargs) {
+  loadModel(qargs->output + ".bin");
+  if (quant_ || args_->model != model_name::sup) {
+    std::cerr << "Only supervised models that are not quantized can be pruned!"
+              << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  int64_t rows = input_->m_;
+  if (qargs->cutoff <= 0 || qargs->cutoff >= rows) {
+    std::cerr << "Cutoff must be between 1 and the number of input rows ("
+              << rows << ")!" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  Vector row(args_->dim);
+  std::vector<real> norms(rows), scores(rows, 0.0);
+  for (int64_t i = 0; i < rows; i++) {
+    input_->getRow(i, row.data_);
+    real n = 0.0;
+    for (int64_t j = 0; j < args_->dim; j++) {
+      n += row[j] * row[j];
+    }
+    norms[i] = n;
+  }
+  if (!qargs->validation.empty()) {
+    std::ifstream ifs(qargs->validation);
+    if (!ifs.is_open()) {
+      std::cerr << "Validation file cannot be opened!" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    std::vector<int32_t> line, labels;
+    while (ifs.peek() != EOF) {
+      dict_->getLine(ifs, line, labels, model_->rng);
+      dict_->addNgrams(line, args_->wordNgrams);
+      if (labels.empty() || line.empty()) continue;
+      for (auto it = line.cbegin(); it != line.cend(); ++it) {
+        input_->getRow(*it, row.data_);
+        for (auto lt = labels.cbegin(); lt != labels.cend(); ++lt) {
+          scores[*it] += std::abs(output_->dotRow(row, *lt)) / line.size();
+        }
+      }
+    }
+  }
+  std::vector<int32_t> idx(rows);
+  for (int64_t i = 0; i < rows; i++) {
+    idx[i] = i;
+  }
+  std::nth_element(idx.begin(), idx.begin() + qargs->cutoff, idx.end(),
+                   [&](int32_t a, int32_t b) {
+    if (scores[a] != scores[b]) return scores[a] > scores[b];
+    return norms[a] > norms[b];
+  });
+  idx.resize(qargs->cutoff);
+
+  int64_t before = input_->bytes();
+  dict_->prune(idx);
+  auto input = std::make_shared<Matrix>(idx.size(), args_->dim, args_->storage);
+  for (size_t i = 0; i < idx.size(); i++) {
+    input_->getRow(idx[i], row.data_);
+    input->setRow(i, row.data_);
+  }
+  input_ = input;
+  model_ = std::make_shared<Model>(input_, output_, args_, 0);
+  model_->setTargetCounts(dict_->getCounts(entry_type::label));
+  args_->output = qargs->output + ".pruned";
+  if (qargs->verbose > 0) {
+    std::cout << "Number of words:  " << dict_->nwords() << std::endl;
+    std::cout << "Input matrix: " << before / 1000000.0 << "MB -> "
+              << input_->bytes() / 1000000.0 << "MB" << std::endl;
+  }
+  saveModel();
+}
+
+// builds the index of the word vectors or of the label rows of
+// <output>.bin, saved as <output>.words.ivf or <output>.labels.ivf
+void FastText::index(std::shared_ptr<Args> qargs) {
+  loadModel(qargs->output + ".bin");
+  std::string filename = qargs->output;
+  if (qargs->indexFor == index_target::labels) {
+    if (args_->model != model_name::sup || args_->loss == loss_name::hs || qoutput_) {
+      std::cerr << "Label indexes need a supervised model trained without hs "
+                << "and with its output matrix not quantized!" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    filename += ".labels.ivf";
+    IvfIndex::build(*output_, qargs->nlist, qargs->nprobe, qargs->seed, filename);
+  } else {
+    Matrix wordVectors;
+    precomputeWordVectors(wordVectors);
+    filename += ".words.ivf";
+    IvfIndex::build(wordVectors, qargs->nlist, qargs->nprobe, qargs->seed, filename);
+  }
+  if (qargs->verbose > 0) {
+    IvfIndex index;
+    index.load(filename);
+    std::cout << "Index: " << index.n_ << " rows in " << index.nlist_
+              << " lists, " << index.nprobe_ << " probed" << std::endl;
+  }
+}
+
+// loads the indexes saved next to a model file, if any; nprobe <= 0
+// keeps the default of each index
+void FastText::loadIndexes(const std::string& filename, int32_t nprobe) {
+  std::string prefix = filename;
+  size_t dot = prefix.rfind('.');
+  if (dot != std::string::npos &&
+      (prefix.substr(dot) == ".bin" || prefix.substr(dot) == ".ftz")) {
+    prefix = prefix.substr(0, dot);
+  }
+  nprobe_ = nprobe;
+  if (std::ifstream(prefix + ".words.ivf").good()) {
+    wordIndex_ = std::make_shared<IvfIndex>();
+    wordIndex_->load(prefix + ".words.ivf");
+    if (wordIndex_->n_ != dict_->nwords() || wordIndex_->dim_ != args_->dim) {
+      std::cerr << "Word index does not match the model!" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+  if (args_->model == model_name::sup && args_->loss != loss_name::hs &&
+      std::ifstream(prefix + ".labels.ivf").good()) {
+    labelIndex_ = std::make_shared<IvfIndex>();
+    labelIndex_->load(prefix + ".labels.ivf");
+    if (labelIndex_->n_ != dict_->nlabels() || labelIndex_->dim_ != args_->dim) {
+      std::cerr << "Label index does not match the model!" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    model_->setLabelIndex(labelIndex_, nprobe);
+  }
+}
+
+// A model trained before, to train further on the input. Its shape (dim,
+// loss, subwords) replaces the command line's; the dictionary grows with
+// the new words and labels, and the matrices with rows for them.
+void FastText::loadInputModel() {
+  std::ifstream ifs(args_->inputModel, std::ifstream::binary);
   if (!ifs.is_open()) {
-    std::cerr << "Input file cannot be opened!" << std::endl;
+    std::cerr << "Input model cannot be opened for loading!" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  int32_t magic, version = 0;
+  ifs.read((char*) &magic, sizeof(int32_t));
+  if (magic == FASTTEXT_FILEFORMAT_MAGIC_INT32) {
+    ifs.read((char*) &version, sizeof(int32_t));
+  } else {
+    ifs.seekg(-int64_t(sizeof(int32_t)), std::ios::cur);
+  }
+  if (version > FASTTEXT_VERSION) {
+    std::cerr << "Model file was saved by a newer version!" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  Args saved;
+  saved.load(ifs, version);
+  if (saved.model != args_->model || saved.model == model_name::pwv) {
+    std::cerr << "Input model cannot be trained further by this command!" << std::endl;
     exit(EXIT_FAILURE);
   }
-  dict_->readFromFile(ifs);
+  args_->dim = saved.dim;
+  args_->loss = saved.loss;
+  args_->wordNgrams = saved.wordNgrams;
+  args_->bucket = saved.bucket;
+  args_->minn = saved.minn;
+  args_->maxn = saved.maxn;
+  args_->storage = saved.storage;
+  dict_->load(ifs, version);
+  bool quant = false, qout = false;
+  if (version >= 2) {
+    ifs.read((char*) &quant, sizeof(bool));
+  }
+  if (quant || dict_->isPruned()) {
+    std::cerr << "Quantized or pruned models cannot be trained further!" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  auto input = std::make_shared<Matrix>(args_->storage);
+  input->load(ifs);
+  if (version >= 2) {
+    ifs.read((char*) &qout, sizeof(bool));
+  }
+  if (qout) {
+    std::cerr << "Quantized or pruned models cannot be trained further!" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  auto output = std::make_shared<Matrix>(args_->storage);
+  output->load(ifs);
   ifs.close();
 
-// set dim to number of labels (ddu)
+  int32_t nwords = dict_->nwords();
+  dict_->update(corpus_->begin(), corpus_->end());
+  // known rows keep their values, the buckets move past the new words;
+  // new rows start as they would in a new run
+  int64_t shift = dict_->nwords() - nwords;
+  input_ = std::make_shared<Matrix>(dict_->nwords() + args_->bucket, args_->dim, args_->storage);
+  placeMatrix(*input_);
+  input_->uniform(1.0 / args_->dim, args_->seed, args_->thread);
+  std::vector<real> row(args_->dim);
+  for (int64_t i = 0; i < input->m_; i++) {
+    input->getRow(i, row.data());
+    input_->setRow(i < nwords ? i : i + shift, row.data());
+  }
+  if (args_->model == model_name::sup) {
+    output_ = std::make_shared<Matrix>(dict_->nlabels(), args_->dim, args_->storage);
+  } else {
+    output_ = std::make_shared<Matrix>(dict_->nwords(), args_->dim, args_->storage);
+  }
+  placeMatrix(*output_);
+  for (int64_t i = 0; i < output->m_; i++) {
+    output->getRow(i, row.data());
+    output_->setRow(i, row.data());
+  }
+}
+
+// fresh matrices for a new run, from the dictionary just read
+void FastText::initMatrices() {
+  // set dim to number of labels (ddu)
   if( args_->model == model_name::pwv) { 
     args_->dim = dict_->nlabels();
   }
 
   if (args_->model == model_name::sup) {
-    output_ = std::make_shared<Matrix>(dict_->nlabels(), args_->dim);
+    output_ = std::make_shared<Matrix>(dict_->nlabels(), args_->dim, args_->storage);
+  } else {
+    output_ = std::make_shared<Matrix>(dict_->nwords(), args_->dim, args_->storage);
+  }
+  if (args_->replicaSync > 0 && numa::nodes() > 1) {
+    numa::bind(output_->ptr(), output_->bytes(), 0);
   } else {
-    output_ = std::make_shared<Matrix>(dict_->nwords(), args_->dim);
+    placeMatrix(*output_);
   }
 
   //input_->uniform(1.0 / args_->dim);
   //output_->zero();
 
   // initialized vectors with labels (ddu)
-  auto words = dict_->getWords();
-  output_->zero();
+  const std::vector<entry>& words = dict_->getWords();
 
     if (args_->pretrainedVectors.size() != 0) {
         loadVectors(args_->pretrainedVectors);
     } else {
 
-        input_ = std::make_shared<Matrix>(dict_->nwords()+args_->bucket, args_->dim);
+        input_ = std::make_shared<Matrix>(dict_->nwords()+args_->bucket, args_->dim, args_->storage);
+        // bucket rows are only initialized once training hits them
+        if(args_->model == model_name::pwv ) {
+          input_->deferConstant(dict_->nwords(), 1.0 / args_->dim);
+        } else if (args_->bucket > 0) {
+          input_->deferUniform(dict_->nwords(), 1.0 / args_->dim, args_->seed);
+        }
+        placeMatrix(*input_);
         if(args_->model == model_name::pwv ) {
-          input_->zero();
+          std::vector<real> row(args_->dim);
           for( int32_t i = 0; i < dict_->nwords(); ++i) { // for words
             int32_t non_zero_size = words[i].nlabels;
-            Vector vec = Vector(args_->dim, dict_->getLabels(i));
-            input_->addRow(vec, i, non_zero_size? (1.0/non_zero_size): 0);
-          }
-          for( int32_t i = 0; i < args_->bucket; ++i) { // for buckets (subwords)
-            Vector ones = Vector(args_->dim);
-            ones.ones();
-            input_->addRow(ones, dict_->nwords()+i, 1.0 / args_->dim);
+            std::fill(row.begin(), row.end(), 0.0);
+            for (int32_t l : dict_->getLabels(i)) {
+              row[l] = non_zero_size ? (1.0 / non_zero_size) : 0;
+            }
+            input_->setRow(i, row.data());
           }
         }
         else {
-          input_->uniform(1.0 / args_->dim);
+          input_->uniform(1.0 / args_->dim, args_->seed, args_->thread);
         }  
     }
+}
 
+void FastText::train(std::shared_ptr<Args> args) {
+  steady_clock::time_point begin = steady_clock::now();
+  args_ = args;
+  dict_ = std::make_shared<Dictionary>(args_);
+  if (args_->input == "-") {
+    // manage expectations
+    std::cerr << "Cannot use stdin for training!" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  std::ifstream ifs(args_->input);
+  if (!ifs.is_open()) {
+    std::cerr << "Input file cannot be opened!" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  // checkpoints do not keep the labels of each word that pwv trains with
+  if (args_->model == model_name::pwv && (args_->checkpoint > 0 || args_->resume)) {
+    std::cerr << "pwv cannot be checkpointed or resumed!" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  if (args_->workers > 1) {
+    if (args_->coordinator.empty() || args_->rank < 0 || args_->rank >= args_->workers) {
+      std::cerr << "Training with -workers needs -coordinator and a -rank below -workers!" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    if (args_->checkpoint > 0 || args_->resume) {
+      std::cerr << "Checkpoints cannot be used with -workers!" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+  // tokenizers move past a chunk before its batches are trained
+  if (args_->pipeline > 0 && (args_->checkpoint > 0 || args_->resume)) {
+    std::cerr << "Checkpoints cannot be used with -pipeline!" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  corpus_ = std::make_shared<utils::MappedFile>(args_->input);
+  int32_t readers = args_->pipeline > 0 ? args_->pipeline : args_->thread;
+  int32_t epochs = args_->timeBudget > 0 ? BUDGET_EPOCHS : args_->epoch;
+  resumed_ = 0;
+  if (args_->resume) {
+    loadCheckpoint(readers);
+  } else if (!args_->inputModel.empty()) {
+    loadInputModel();
+    scheduler_ = std::make_shared<ChunkScheduler>(ifs, readers, epochs,
+                                                  args_->rank, args_->workers);
+  } else {
+    dict_->readFromFile(corpus_->begin(), corpus_->end());
+    scheduler_ = std::make_shared<ChunkScheduler>(ifs, readers, epochs,
+                                                  args_->rank, args_->workers);
+    initMatrices();
+  }
+  ifs.close();
+  bool saves = fit(begin);
+  corpus_.reset();
+  if (!saves) return;
+  model_ = std::make_shared<Model>(input_, output_, args_, 0);
+
+  saveModel();
+  if (args_->model != model_name::sup) {
+    saveVectors();
+  }
+  if (args_->checkpoint > 0 || args_->resume) {
+    remove((args_->output + ".ckpt").c_str());
+  }
+}
+
+// Trains input_ and output_ on corpus_ with the chunks of scheduler_; the
+// time budget counts from begin. False when another process saves the
+// model.
+bool FastText::fit(steady_clock::time_point begin) {
+  std::vector<std::vector<int32_t>> vlines, vlabels;
+  if (!args_->validation.empty()) {
+    readValidation(vlines, vlabels);
+    for (auto& line : vlines) {
+      dict_->addNgrams(line, args_->wordNgrams);
+    }
+  }
+  const int64_t ntokens = dict_->nlineTokens() * scheduler_->share();
+  replicateOutput();
+  // every process starts from the same matrices; rank 0 also keeps the
+  // average of all of them
+  std::shared_ptr<Coordinator> coordinator;
+  std::thread coordinatorThread;
+  if (args_->workers > 1) {
+    if (args_->rank == 0) {
+      coordinator = std::make_shared<Coordinator>(
+          args_->coordinator, args_->workers,
+          std::vector<std::shared_ptr<Matrix>>{input_, output_});
+      coordinatorThread = std::thread([coordinator]() { coordinator->run(); });
+    }
+    sync_ = std::make_shared<SyncClient>(args_->coordinator);
+    input_->trackDirty();
+    output_->trackDirty();
+  }
+  if (args_->verbose > 1) {
+    std::cout << "Huge pages:       " << input_->hugePages() + output_->hugePages() << std::endl;
+  }
+  if (args_->timeBudget > 0) {
+    // saving takes about as long as loading, so the time spent so far is
+    // kept back at the end
+    trainStart_ = steady_clock::now();
+    trainEnd_ = begin + std::chrono::seconds(args_->timeBudget) - (trainStart_ - begin);
+    if (trainEnd_ <= trainStart_) {
+      std::cerr << "Time budget is too short to train!" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  }
   start = clock();
-  tokenCount = 0;
+  tokenCount = std::make_shared<ProgressCounter>(args_->thread);
+  tokenCount->add(0, resumed_);
   std::vector<std::thread> threads;
+  if (args_->pipeline > 0) {
+    pipeline_ = std::make_shared<Pipeline>(args_->pipeline, args_->thread);
+    for (int32_t i = 0; i < args_->pipeline; i++) {
+      threads.push_back(std::thread([=]() { tokenizeThread(i); }));
+    }
+  }
   for (int32_t i = 0; i < args_->thread; i++) {
     threads.push_back(std::thread([=]() { trainThread(i); }));
   }
+  // background tasks run every so many seconds until training ends
+  std::mutex mtx;
+  std::condition_variable cv;
+  bool trained = false;
+  std::vector<std::thread> monitors;
+  auto every = [&](int32_t seconds, std::function<void()> task) {
+    monitors.push_back(std::thread([&, seconds, task]() {
+      std::unique_lock<std::mutex> lock(mtx);
+      while (!cv.wait_for(lock, std::chrono::seconds(seconds),
+                          [&trained] { return trained; })) {
+        lock.unlock();
+        task();
+        lock.lock();
+      }
+    }));
+  };
+  if (args_->checkpoint > 0) {
+    every(args_->checkpoint, [this]() { saveCheckpoint(); });
+  }
+  std::shared_ptr<Model> validator;
+  real best = -1.0;
+  int32_t stale = 0;
+  if (!vlines.empty()) {
+    validator = std::make_shared<Model>(input_, output_, args_, 0);
+    validator->setTargetCounts(dict_->getCounts(entry_type::label));
+    every(args_->validationInterval, [&]() {
+      double seconds = 0.0;
+      real precision = evaluate(*validator, 1, args_->dim, dict_->nlabels(),
+                                vlines, vlabels, seconds) / vlines.size();
+      real progress = args_->timeBudget > 0 ? timeProgress() :
+          std::min(real(tokenCount->total()) / (args_->epoch * ntokens), real(1.0));
+      if (args_->verbose > 0) {
+        std::cout << std::fixed << std::setprecision(1) << "\rValidation at "
+                  << 100 * progress << "%:  P@1: " << std::setprecision(3)
+                  << precision << std::endl;
+      }
+      if (precision > best) {
+        best = precision;
+        stale = 0;
+      } else if (args_->patience > 0 && ++stale == args_->patience) {
+        if (args_->verbose > 0) {
+          std::cout << "No improvement in " << stale
+                    << " validations, stopping" << std::endl;
+        }
+        scheduler_->stop();
+      }
+    });
+  }
   for (auto it = threads.begin(); it != threads.end(); ++it) {
     it->join();
   }
-  model_ = std::make_shared<Model>(input_, output_, args_, 0);
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    trained = true;
+  }
+  cv.notify_all();
+  for (auto it = monitors.begin(); it != monitors.end(); ++it) {
+    it->join();
+  }
+  if (pipeline_ && args_->verbose > 0) {
+    pipeline_->report(std::cout);
+  }
+  pipeline_.reset();
+  if (outputs_.size() > 1) {
+    averageReplicas();
+    outputs_.clear();
+  }
+  if (sync_) {
+    sync_->sync({input_, output_}, true);
+    sync_.reset();
+    if (!coordinator) {
+      if (args_->verbose > 0) {
+        std::cout << "Rank " << args_->rank << " done, rank 0 saves the model" << std::endl;
+      }
+      return false;
+    }
+    coordinatorThread.join();
+    input_ = coordinator->model()[0];
+    output_ = coordinator->model()[1];
+  }
+  if (args_->verbose > 1 && args_->bucket > 0) {
+    std::cout << "\nBucket rows:      " << input_->materialized() << " / "
+              << args_->bucket << " touched" << std::endl;
+  }
+  return true;
+}
 
+// Trains a polarized embedding and then a classifier starting from it,
+// both on the one dictionary and mapping of the input, so the word
+// vectors are handed over in memory instead of through a .vec file.
+void FastText::pwvSupervised(std::shared_ptr<Args> args) {
+  steady_clock::time_point begin = steady_clock::now();
+  args_ = args;
+  if (args_->timeBudget > 0 || args_->workers > 1 || args_->checkpoint > 0 ||
+      args_->resume || !args_->inputModel.empty() ||
+      !args_->pretrainedVectors.empty()) {
+    std::cerr << "pwv-supervised cannot be used with -timeBudget, -workers, "
+              << "checkpoints, -inputModel or -pretrainedVectors!" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  std::ifstream ifs(args_->input);
+  if (!ifs.is_open()) {
+    std::cerr << "Input file cannot be opened!" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  // the dictionary follows args_, so it tokenizes for each model in turn
+  dict_ = std::make_shared<Dictionary>(args_);
+  corpus_ = std::make_shared<utils::MappedFile>(args_->input);
+  int32_t readers = args_->pipeline > 0 ? args_->pipeline : args_->thread;
+  resumed_ = 0;
+  dict_->readFromFile(corpus_->begin(), corpus_->end());
+  std::string validation = args_->validation;
+  args_->validation = "";
+  scheduler_ = std::make_shared<ChunkScheduler>(ifs, readers, args_->epoch);
+  initMatrices();
+  fit(begin);
+
+  // word rows take the vectors saveVectors would write, subwords included;
+  // those of other words are all bucket rows, so this can run in place
+  Vector vec(args_->dim);
+  for (int32_t i = 0; i < dict_->nwords(); i++) {
+    const std::vector<int32_t>& ngrams = dict_->getNgrams(i);
+    vec.zero();
+    for (auto it = ngrams.begin(); it != ngrams.end(); ++it) {
+      vec.addRow(*input_, *it);
+    }
+    if (ngrams.size() > 0) {
+      vec.mul(1.0 / ngrams.size());
+    }
+    input_->setRow(i, vec.data_);
+  }
+  args_->model = model_name::sup;
+  args_->loss = args_->classifierLoss;
+  args_->lr = args_->classifierLr;
+  args_->epoch = args_->classifierEpoch;
+  args_->validation = validation;
+  output_ = std::make_shared<Matrix>(dict_->nlabels(), args_->dim, args_->storage);
+  placeMatrix(*output_);
+  scheduler_ = std::make_shared<ChunkScheduler>(ifs, readers, args_->epoch);
+  ifs.close();
+  fit(steady_clock::now());
+  corpus_.reset();
+  model_ = std::make_shared<Model>(input_, output_, args_, 0);
   saveModel();
-  if (args_->model != model_name::sup) {
-    saveVectors();
+}
+
+// Trains many supervised models at once on the dictionary and tokens read
+// here a single time, and saves the one scoring best on -validation
+// within -timeBudget.
+void FastText::autotune(std::shared_ptr<Args> args) {
+  steady_clock::time_point begin = steady_clock::now();
+  args_ = args;
+  if (args_->validation.empty() || args_->timeBudget <= 0) {
+    std::cerr << "Autotuning needs -validation and -timeBudget!" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  dict_ = std::make_shared<Dictionary>(args_);
+  corpus_ = std::make_shared<utils::MappedFile>(args_->input);
+  dict_->readFromFile(corpus_->begin(), corpus_->end());
+  LineBatch corpus;
+  std::minstd_rand rng(args_->seed);
+  std::vector<int32_t> line, labels;
+  const char* p = corpus_->begin();
+  while (p < corpus_->end()) {
+    int32_t n = dict_->getLine(p, corpus_->end(), line, labels, rng);
+    corpus.add(line, labels, n);
   }
+  corpus_.reset();
+  std::vector<std::vector<int32_t>> vlines, vlabels;
+  readValidation(vlines, vlabels);
+
+  // as in train, the time taken so far is kept back for saving
+  steady_clock::time_point now = steady_clock::now();
+  Autotune tuner(args_, dict_, corpus, vlines, vlabels,
+                 begin + std::chrono::seconds(args_->timeBudget) - (now - begin));
+  Trial best = tuner.run();
+  if (!best.args) {
+    std::cerr << "No trial finished within the time budget!" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  args_ = best.args;
+  input_ = best.input;
+  output_ = best.output;
+  model_ = std::make_shared<Model>(input_, output_, args_, 0);
+  saveModel();
 }
 
 }
@@ -20,36 +20,79 @@
 
 #include <time.h>
 
-#include <atomic>
+#include <chrono>
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "matrix.h"
 #include "vector.h"
 #include "dictionary.h"
 #include "model.h"
+#include "qmatrix.h"
+#include "int8matrix.h"
+#include "ivfindex.h"
+#include "numa.h"
+#include "pipeline.h"
+#include "progress.h"
+#include "scheduler.h"
+#include "sync.h"
 #include "utils.h"
+#include "vectors.h"
 #include "real.h"
 #include "args.h"
+#include "autotune.h"
+
+#define FASTTEXT_VERSION 3
+#define FASTTEXT_FILEFORMAT_MAGIC_INT32 793712314
 
 namespace fasttext {
 
 class FastText {
   private:
+    typedef std::chrono::steady_clock steady_clock;
+
+    // -timeBudget loops over the data until time is up, at most this often
+    static const int32_t BUDGET_EPOCHS = 1000;
+
     std::shared_ptr<Args> args_;
     std::shared_ptr<Dictionary> dict_;
     std::shared_ptr<Matrix> input_;
     std::shared_ptr<Matrix> output_;
+    std::vector<std::shared_ptr<Matrix>> outputs_; // per-node replicas
+    std::shared_ptr<QMatrix> qinput_;
+    std::shared_ptr<QMatrix> qoutput_;
+    bool quant_;
     std::shared_ptr<Model> model_;
-    std::atomic<int64_t> tokenCount;
+    std::shared_ptr<IvfIndex> wordIndex_;
+    std::shared_ptr<IvfIndex> labelIndex_;
+    int32_t nprobe_;
+    std::shared_ptr<ChunkScheduler> scheduler_;
+    std::shared_ptr<utils::MappedFile> corpus_;
+    std::shared_ptr<Pipeline> pipeline_;
+    std::shared_ptr<SyncClient> sync_; // to the coordinator, with -workers
+    std::shared_ptr<ProgressCounter> tokenCount;
+    int64_t resumed_; // tokens trained on before a resume
     clock_t start;
+    steady_clock::time_point trainStart_; // training window of -timeBudget
+    steady_clock::time_point trainEnd_;
 
   public:
-    void getVector(Vector&, const std::string&);
+    FastText();
+
+    std::shared_ptr<const Args> getArgs() const;
+    std::shared_ptr<const Dictionary> getDictionary() const;
+    void getVector(Vector&, const std::string&) const;
+    void addInputRow(Vector&, int32_t) const;
     void saveVectors();
     void saveModel();
+    void saveModel(std::ostream&);
+    void saveCheckpoint();
+    void loadCheckpoint(int32_t);
     void loadModel(const std::string&);
     void loadModel(std::istream&);
     void printInfo(real, real);
+    real timeProgress() const;
 
     void supervised(Model&, real, const std::vector<int32_t>&,
                     const std::vector<int32_t>&);
@@ -57,13 +100,42 @@ class FastText {
     void skipgram(Model&, real, const std::vector<int32_t>&);
     void pwv(Model&, real, const std::vector<int32_t>&);     
     void test(std::istream&, int32_t);
+    void testInt8(std::istream&, int32_t);
+    void readValidation(std::vector<std::vector<int32_t>>&,
+                        std::vector<std::vector<int32_t>>&);
     void predict(std::istream&, int32_t, bool);
     void predict(std::istream&, int32_t, std::vector<std::pair<real,std::string>>&) const;
+    void predict(std::istream&, int32_t, std::vector<std::pair<real,std::string>>&,
+                 Vector&, Vector&, std::minstd_rand&) const;
+    void predict(std::istream&, int32_t, std::vector<std::pair<real,int32_t>>&,
+                 Vector&, Vector&, std::minstd_rand&) const;
     void wordVectors();
     void textVectors();
     void printVectors();
+    void precomputeWordVectors(Matrix&) const;
+    void findNN(const Matrix&, const Vector&, int32_t,
+                const std::vector<std::string>&,
+                std::vector<std::pair<real, std::string>>&) const;
+    void findNNIndexed(const Vector&, int32_t,
+                       const std::vector<std::string>&,
+                       std::vector<std::pair<real, std::string>>&) const;
+    void nn(int32_t);
+    void analogies(int32_t);
+    void placeMatrix(Matrix&);
+    void replicateOutput();
+    void averageReplicas();
+    void loadInputModel();
+    void initMatrices();
     void trainThread(int32_t);
+    void tokenizeThread(int32_t);
+    bool fit(steady_clock::time_point);
     void train(std::shared_ptr<Args>);
+    void pwvSupervised(std::shared_ptr<Args>);
+    void autotune(std::shared_ptr<Args>);
+    void quantize(std::shared_ptr<Args>);
+    void prune(std::shared_ptr<Args>);
+    void index(std::shared_ptr<Args>);
+    void loadIndexes(const std::string&, int32_t);
 
     void loadVectors(std::string);
 };
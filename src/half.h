@@ -0,0 +1,101 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#ifndef FASTTEXT_HALF_H
+#define FASTTEXT_HALF_H
+
+#include <cstdint>
+#include <cstring>
+
+#include "real.h"
+
+namespace fasttext {
+
+namespace half {
+
+  inline uint32_t bits(float f) {
+    uint32_t w;
+    memcpy(&w, &f, sizeof(w));
+    return w;
+  }
+
+  inline float value(uint32_t w) {
+    float f;
+    memcpy(&f, &w, sizeof(f));
+    return f;
+  }
+
+  // bfloat16 is the top half of a float
+  inline real bf16ToReal(uint16_t h) {
+    return value(uint32_t(h) << 16);
+  }
+
+  // round to nearest even
+  inline uint16_t realToBf16(real f) {
+    uint32_t w = bits(f);
+    if ((w & 0x7fffffff) > 0x7f800000) {
+      return (w >> 16) | 0x40; // keep NaNs quiet
+    }
+    return (w + 0x7fff + ((w >> 16) & 1)) >> 16;
+  }
+
+  // stochastic rounding: round up with probability equal to the dropped
+  // fraction, so updates far below one ulp still add up in expectation
+  inline uint16_t realToBf16(real f, uint32_t noise) {
+    uint32_t w = bits(f);
+    if ((w & 0x7fffffff) >= 0x7f7f0000) {
+      return realToBf16(f);
+    }
+    return (w + (noise & 0xffff)) >> 16;
+  }
+
+  // IEEE half precision, converted without branches on the value so the
+  // loops around these calls still vectorize
+  inline real fp16ToReal(uint16_t h) {
+    const uint32_t w = uint32_t(h) << 16;
+    const uint32_t sign = w & 0x80000000;
+    const uint32_t two_w = w + w;
+    const float normalized = value((two_w >> 4) + (0xE0u << 23)) * value(0x7800000);
+    const float denormalized = value((two_w >> 17) | (126u << 23)) - 0.5f;
+    const uint32_t result = sign |
+      (two_w < (1u << 27) ? bits(denormalized) : bits(normalized));
+    return value(result);
+  }
+
+  inline uint16_t realToFp16(real f) {
+    const float scale_to_inf = value(0x77800000);
+    const float scale_to_zero = value(0x08800000);
+    float base = (f < 0 ? -f : f) * scale_to_inf * scale_to_zero;
+    const uint32_t w = bits(f);
+    const uint32_t shl1_w = w + w;
+    const uint32_t sign = w & 0x80000000;
+    uint32_t bias = shl1_w & 0xFF000000;
+    if (bias < 0x71000000) {
+      bias = 0x71000000;
+    }
+    base = value((bias >> 1) + 0x07800000) + base;
+    const uint32_t out = bits(base);
+    const uint32_t exp_bits = (out >> 13) & 0x00007C00;
+    const uint32_t mantissa_bits = out & 0x00000FFF;
+    const uint32_t nonsign = exp_bits + mantissa_bits;
+    return (sign >> 16) | (shl1_w > 0xFF000000 ? 0x7E00 : nonsign);
+  }
+
+  inline real toReal(uint16_t h, storage_type storage) {
+    return storage == storage_type::bf16 ? bf16ToReal(h) : fp16ToReal(h);
+  }
+
+  inline uint16_t fromReal(real f, storage_type storage) {
+    return storage == storage_type::bf16 ? realToBf16(f) : realToFp16(f);
+  }
+}
+
+}
+
+#endif
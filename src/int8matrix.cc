@@ -0,0 +1,193 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include "int8matrix.h"
+
+#include <assert.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include "allocator.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define FASTTEXT_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace fasttext {
+
+namespace {
+
+  // exact sum of h[j] * w[j]; n is a multiple of 32 and wsum is the sum
+  // of w, which kernels working on unsigned h need to correct for
+  typedef int32_t (*dot_fn)(const int8_t*, const int8_t*, int64_t, int32_t);
+  // y[j] += a * x[j]; n is a multiple of 8
+  typedef void (*axpy_fn)(real*, const int8_t*, real, int64_t);
+
+  int32_t dotScalar(const int8_t* h, const int8_t* w, int64_t n, int32_t) {
+    int32_t d = 0;
+    for (int64_t j = 0; j < n; j++) {
+      d += int32_t(h[j]) * int32_t(w[j]);
+    }
+    return d;
+  }
+
+  void axpyScalar(real* y, const int8_t* x, real a, int64_t n) {
+    for (int64_t j = 0; j < n; j++) {
+      y[j] += a * x[j];
+    }
+  }
+
+#ifdef FASTTEXT_X86_KERNELS
+  __attribute__((target("avx2")))
+  int32_t hsum(__m256i v) {
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(v),
+                              _mm256_extracti128_si256(v, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(s);
+  }
+
+  __attribute__((target("avx2")))
+  int32_t dotAvx2(const int8_t* h, const int8_t* w, int64_t n, int32_t) {
+    __m256i acc = _mm256_setzero_si256();
+    for (int64_t j = 0; j < n; j += 16) {
+      __m256i a = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*) (h + j)));
+      __m256i b = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*) (w + j)));
+      acc = _mm256_add_epi32(acc, _mm256_madd_epi16(a, b));
+    }
+    return hsum(acc);
+  }
+
+  // vpdpbusd multiplies unsigned by signed bytes: shift h by 128 and take
+  // 128 * sum(w) back off at the end
+  __attribute__((target("avx2,avx512f,avx512vl,avx512vnni")))
+  int32_t dotVnni(const int8_t* h, const int8_t* w, int64_t n, int32_t wsum) {
+    const __m256i bias = _mm256_set1_epi8(char(0x80));
+    __m256i acc = _mm256_setzero_si256();
+    for (int64_t j = 0; j < n; j += 32) {
+      __m256i a = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*) (h + j)), bias);
+      __m256i b = _mm256_loadu_si256((const __m256i*) (w + j));
+      acc = _mm256_dpbusd_epi32(acc, a, b);
+    }
+    return hsum(acc) - 128 * wsum;
+  }
+
+  __attribute__((target("avx2,fma")))
+  void axpyAvx2(real* y, const int8_t* x, real a, int64_t n) {
+    const __m256 va = _mm256_set1_ps(a);
+    for (int64_t j = 0; j < n; j += 8) {
+      __m128i b = _mm_loadl_epi64((const __m128i*) (x + j));
+      __m256 f = _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(b));
+      _mm256_storeu_ps(y + j, _mm256_fmadd_ps(va, f, _mm256_loadu_ps(y + j)));
+    }
+  }
+#endif
+
+  struct Kernels {
+    dot_fn dot;
+    axpy_fn axpy;
+    const char* name;
+  };
+
+  // picked once, from what the running CPU supports
+  const Kernels& kernels() {
+    static const Kernels k = [] {
+#ifdef FASTTEXT_X86_KERNELS
+      __builtin_cpu_init();
+      if (__builtin_cpu_supports("avx512vnni") &&
+          __builtin_cpu_supports("avx512vl") && __builtin_cpu_supports("fma")) {
+        return Kernels{dotVnni, axpyAvx2, "avx512-vnni"};
+      }
+      if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return Kernels{dotAvx2, axpyAvx2, "avx2"};
+      }
+#endif
+      return Kernels{dotScalar, axpyScalar, "scalar"};
+    }();
+    return k;
+  }
+
+  real quantize(const real* x, int64_t n, int8_t* q) {
+    real max = 0.0;
+    for (int64_t j = 0; j < n; j++) {
+      max = std::max(max, std::abs(x[j]));
+    }
+    real scale = max > 0 ? max / 127.0 : 1.0;
+    real inv = 1.0 / scale;
+    for (int64_t j = 0; j < n; j++) {
+      q[j] = int8_t(std::lrint(x[j] * inv));
+    }
+    return scale;
+  }
+}
+
+Int8Matrix::Int8Matrix(const Matrix& mat)
+  : m_(mat.m_), n_(mat.n_), stride_(allocator::padded(mat.n_, 1))
+{
+  data_.assign(m_ * stride_, 0);
+  scales_.resize(m_);
+  sums_.resize(m_);
+  std::vector<real> row(n_);
+  for (int64_t i = 0; i < m_; i++) {
+    mat.getRow(i, row.data());
+    int8_t* q = data_.data() + i * stride_;
+    scales_[i] = quantize(row.data(), n_, q);
+    sums_[i] = 0;
+    for (int64_t j = 0; j < n_; j++) {
+      sums_[i] += q[j];
+    }
+  }
+}
+
+// hidden vectors stay in real; rows are widened and scaled as they are added
+void Int8Matrix::addToVector(Vector& x, int64_t i) const {
+  assert(i >= 0);
+  assert(i < m_);
+  assert(x.m_ == n_);
+  kernels().axpy(x.data_, data_.data() + i * stride_, scales_[i],
+                 allocator::padded(n_, sizeof(real)));
+}
+
+real Int8Matrix::dotRow(const Vector& vec, int64_t i) const {
+  assert(i >= 0);
+  assert(i < m_);
+  const int8_t* row = data_.data() + i * stride_;
+  real d = 0.0;
+  for (int64_t j = 0; j < n_; j++) {
+    d += vec[j] * row[j];
+  }
+  return d * scales_[i];
+}
+
+// scores of every row: vec is brought to int8 once and each row costs a
+// single integer dot product
+void Int8Matrix::mulAll(const Vector& vec, Vector& out) const {
+  assert(vec.m_ == n_);
+  assert(out.m_ == m_);
+  static thread_local std::vector<int8_t> q;
+  q.assign(stride_, 0);
+  real scale = quantize(vec.data_, n_, q.data());
+  const Kernels& k = kernels();
+  for (int64_t i = 0; i < m_; i++) {
+    int32_t d = k.dot(q.data(), data_.data() + i * stride_, stride_, sums_[i]);
+    out[i] = d * scale * scales_[i];
+  }
+}
+
+int64_t Int8Matrix::bytes() const {
+  return data_.size() + scales_.size() * sizeof(real) + sums_.size() * sizeof(int32_t);
+}
+
+const char* Int8Matrix::kernel() {
+  return kernels().name;
+}
+
+}
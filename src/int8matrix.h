@@ -0,0 +1,47 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#ifndef FASTTEXT_INT8MATRIX_H
+#define FASTTEXT_INT8MATRIX_H
+
+#include <cstdint>
+#include <vector>
+
+#include "matrix.h"
+#include "real.h"
+#include "vector.h"
+
+namespace fasttext {
+
+// Inference-only copy of a matrix: every row is scaled into int8 with its
+// own factor. Rows are padded with zeros to 32 bytes for the SIMD kernels.
+class Int8Matrix {
+  private:
+    std::vector<int8_t> data_;
+    std::vector<real> scales_;
+    std::vector<int32_t> sums_;
+
+  public:
+    int64_t m_;
+    int64_t n_;
+    int64_t stride_;
+
+    explicit Int8Matrix(const Matrix&);
+
+    void addToVector(Vector&, int64_t) const;
+    real dotRow(const Vector&, int64_t) const;
+    void mulAll(const Vector&, Vector&) const;
+    int64_t bytes() const;
+
+    static const char* kernel();
+};
+
+}
+
+#endif
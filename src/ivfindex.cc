@@ -0,0 +1,309 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include "ivfindex.h"
+
+#include <stdlib.h>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <queue>
+#include <random>
+#include <thread>
+
+#include "allocator.h"
+#include "utils.h"
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fasttext {
+
+const int32_t IvfIndex::MAGIC;
+const int32_t IvfIndex::VERSION;
+const int64_t IvfIndex::HEADER;
+
+// k-means runs on a sample of this many rows per list
+const int64_t SAMPLE_PER_LIST = 64;
+const int32_t KMEANS_ITERATIONS = 10;
+
+IvfIndex::IvfIndex() : map_(nullptr), mapSize_(0), centroids_(nullptr),
+    offsets_(nullptr), ids_(nullptr), rows_(nullptr), n_(0), dim_(0),
+    stride_(0), nlist_(0), nprobe_(0) {}
+
+IvfIndex::~IvfIndex() {
+#ifdef __linux__
+  if (map_ != nullptr) {
+    munmap(map_, mapSize_);
+  }
+#endif
+}
+
+int64_t IvfIndex::aligned(int64_t offset) {
+  return (offset + allocator::ALIGNMENT - 1) / allocator::ALIGNMENT *
+         allocator::ALIGNMENT;
+}
+
+void normalizeRow(real* x, int64_t n) {
+  real norm = utils::dotPadded(x, x, n);
+  if (norm > 0) {
+    norm = 1.0 / std::sqrt(norm);
+    for (int64_t j = 0; j < n; j++) {
+      x[j] *= norm;
+    }
+  }
+}
+
+// list whose centroid has the largest dot product with x
+int32_t nearest(const real* x, const std::vector<real>& centroids,
+                int64_t nlist, int64_t stride) {
+  int32_t best = 0;
+  real score = utils::dotPadded(x, centroids.data(), stride);
+  for (int64_t c = 1; c < nlist; c++) {
+    real s = utils::dotPadded(x, centroids.data() + c * stride, stride);
+    if (s > score) {
+      score = s;
+      best = c;
+    }
+  }
+  return best;
+}
+
+// Spherical k-means on the row directions, so lists group rows pointing
+// the same way; the rows themselves are stored unnormalized, so scores
+// are the exact inner products the model uses.
+void IvfIndex::build(const Matrix& mat, int64_t nlist, int32_t nprobe,
+                     int32_t seed, const std::string& filename) {
+  int64_t n = mat.m_, dim = mat.n_;
+  int64_t stride = allocator::padded(dim, sizeof(real));
+  if (nlist <= 0) {
+    nlist = std::max<int64_t>(1, 2 * std::sqrt(n));
+  }
+  nlist = std::max<int64_t>(1, std::min(nlist, n));
+  nprobe = std::max<int32_t>(1, std::min<int64_t>(nprobe, nlist));
+  int32_t threads = std::max(1u, std::thread::hardware_concurrency());
+
+  std::vector<real> rows(n * stride, 0.0), dirs(n * stride, 0.0);
+  utils::parallel(0, n, threads, [&](int32_t, int64_t begin, int64_t end) {
+    for (int64_t i = begin; i < end; i++) {
+      mat.getRow(i, rows.data() + i * stride);
+      std::copy(rows.begin() + i * stride, rows.begin() + (i + 1) * stride,
+                dirs.begin() + i * stride);
+      normalizeRow(dirs.data() + i * stride, stride);
+    }
+  });
+
+  std::minstd_rand rng(seed);
+  std::vector<int64_t> sample(n);
+  for (int64_t i = 0; i < n; i++) {
+    sample[i] = i;
+  }
+  std::shuffle(sample.begin(), sample.end(), rng);
+  sample.resize(std::min(n, nlist * SAMPLE_PER_LIST));
+  int64_t ns = sample.size();
+
+  std::vector<real> centroids(nlist * stride);
+  for (int64_t c = 0; c < nlist; c++) {
+    std::copy(dirs.begin() + sample[c] * stride,
+              dirs.begin() + (sample[c] + 1) * stride,
+              centroids.begin() + c * stride);
+  }
+  std::vector<int32_t> assign(ns);
+  std::vector<int64_t> counts(nlist);
+  std::uniform_int_distribution<int64_t> pick(0, ns - 1);
+  for (int32_t it = 0; it < KMEANS_ITERATIONS; it++) {
+    utils::parallel(0, ns, threads, [&](int32_t, int64_t begin, int64_t end) {
+      for (int64_t s = begin; s < end; s++) {
+        assign[s] = nearest(dirs.data() + sample[s] * stride, centroids,
+                            nlist, stride);
+      }
+    });
+    std::fill(centroids.begin(), centroids.end(), 0.0);
+    std::fill(counts.begin(), counts.end(), 0);
+    for (int64_t s = 0; s < ns; s++) {
+      const real* x = dirs.data() + sample[s] * stride;
+      real* c = centroids.data() + assign[s] * stride;
+      for (int64_t j = 0; j < stride; j++) {
+        c[j] += x[j];
+      }
+      counts[assign[s]]++;
+    }
+    for (int64_t c = 0; c < nlist; c++) {
+      if (counts[c] == 0) {
+        // an empty list restarts from a random row
+        int64_t i = sample[pick(rng)];
+        std::copy(dirs.begin() + i * stride, dirs.begin() + (i + 1) * stride,
+                  centroids.begin() + c * stride);
+      }
+      normalizeRow(centroids.data() + c * stride, stride);
+    }
+  }
+
+  std::vector<int32_t> list(n);
+  utils::parallel(0, n, threads, [&](int32_t, int64_t begin, int64_t end) {
+    for (int64_t i = begin; i < end; i++) {
+      list[i] = nearest(dirs.data() + i * stride, centroids, nlist, stride);
+    }
+  });
+  std::vector<int64_t> offsets(nlist + 1, 0);
+  for (int64_t i = 0; i < n; i++) {
+    offsets[list[i] + 1]++;
+  }
+  for (int64_t c = 0; c < nlist; c++) {
+    offsets[c + 1] += offsets[c];
+  }
+  std::vector<int32_t> ids(n);
+  std::vector<int64_t> next(offsets.begin(), offsets.end() - 1);
+  for (int64_t i = 0; i < n; i++) {
+    ids[next[list[i]]++] = i;
+  }
+
+  std::ofstream ofs(filename, std::ofstream::binary);
+  if (!ofs.is_open()) {
+    std::cerr << "Index file cannot be opened for saving!" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  int64_t centroidsAt = HEADER;
+  int64_t offsetsAt = aligned(centroidsAt + nlist * stride * sizeof(real));
+  int64_t idsAt = aligned(offsetsAt + (nlist + 1) * sizeof(int64_t));
+  int64_t rowsAt = aligned(idsAt + n * sizeof(int32_t));
+  auto pad = [&ofs](int64_t at) {
+    while (int64_t(ofs.tellp()) < at) ofs.put(0);
+  };
+  ofs.write((char*) &MAGIC, sizeof(int32_t));
+  ofs.write((char*) &VERSION, sizeof(int32_t));
+  ofs.write((char*) &n, sizeof(int64_t));
+  ofs.write((char*) &dim, sizeof(int64_t));
+  ofs.write((char*) &stride, sizeof(int64_t));
+  ofs.write((char*) &nlist, sizeof(int64_t));
+  ofs.write((char*) &nprobe, sizeof(int32_t));
+  pad(centroidsAt);
+  ofs.write((char*) centroids.data(), nlist * stride * sizeof(real));
+  pad(offsetsAt);
+  ofs.write((char*) offsets.data(), (nlist + 1) * sizeof(int64_t));
+  pad(idsAt);
+  ofs.write((char*) ids.data(), n * sizeof(int32_t));
+  pad(rowsAt);
+  for (int64_t r = 0; r < n; r++) {
+    ofs.write((char*) (rows.data() + ids[r] * stride), stride * sizeof(real));
+  }
+  ofs.close();
+}
+
+void IvfIndex::load(const std::string& filename) {
+  std::ifstream ifs(filename, std::ifstream::binary);
+  if (!ifs.is_open()) {
+    std::cerr << "Index file cannot be opened for loading!" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  int32_t magic = 0, version = 0;
+  ifs.read((char*) &magic, sizeof(int32_t));
+  ifs.read((char*) &version, sizeof(int32_t));
+  ifs.read((char*) &n_, sizeof(int64_t));
+  ifs.read((char*) &dim_, sizeof(int64_t));
+  ifs.read((char*) &stride_, sizeof(int64_t));
+  ifs.read((char*) &nlist_, sizeof(int64_t));
+  ifs.read((char*) &nprobe_, sizeof(int32_t));
+  if (!ifs || magic != MAGIC || version > VERSION) {
+    std::cerr << "Invalid index file!" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  int64_t offsetsAt = aligned(HEADER + nlist_ * stride_ * sizeof(real));
+  int64_t idsAt = aligned(offsetsAt + (nlist_ + 1) * sizeof(int64_t));
+  int64_t rowsAt = aligned(idsAt + n_ * sizeof(int32_t));
+  int64_t size = rowsAt + n_ * stride_ * sizeof(real);
+  const char* base = nullptr;
+#ifdef __linux__
+  int fd = open(filename.c_str(), O_RDONLY);
+  struct stat st;
+  if (fd >= 0 && fstat(fd, &st) == 0 && st.st_size >= size) {
+    void* map = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map != MAP_FAILED) {
+      map_ = map;
+      mapSize_ = size;
+      base = (const char*) map;
+    }
+  }
+  if (fd >= 0) {
+    close(fd);
+  }
+#endif
+  if (base == nullptr) {
+    buffer_.resize(size);
+    ifs.seekg(0);
+    ifs.read(buffer_.data(), size);
+    if (!ifs) {
+      std::cerr << "Invalid index file!" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    base = buffer_.data();
+  }
+  centroids_ = (const real*) (base + HEADER);
+  offsets_ = (const int64_t*) (base + offsetsAt);
+  ids_ = (const int32_t*) (base + idsAt);
+  rows_ = (const real*) (base + rowsAt);
+}
+
+// Top k rows by inner product with query (padded to stride_), best first.
+// nprobe <= 0 uses the default of the index. logZ, when asked for, gets the
+// log-sum-exp of the scores of every row scanned.
+void IvfIndex::search(const real* query, int32_t k, int32_t nprobe,
+                      std::vector<std::pair<real, int32_t>>& results,
+                      real* logZ) const {
+  if (nprobe <= 0) nprobe = nprobe_;
+  nprobe = std::min<int64_t>(nprobe, nlist_);
+  std::vector<std::pair<real, int32_t>> lists(nlist_);
+  for (int64_t c = 0; c < nlist_; c++) {
+    lists[c].first = utils::dotPadded(query, centroids_ + c * stride_, stride_);
+    lists[c].second = c;
+  }
+  std::partial_sort(lists.begin(), lists.begin() + nprobe, lists.end(),
+                    std::greater<std::pair<real, int32_t>>());
+
+  std::priority_queue<std::pair<real, int32_t>,
+                      std::vector<std::pair<real, int32_t>>,
+                      std::greater<std::pair<real, int32_t>>> heap;
+  real max = -INFINITY, sum = 0.0;
+  for (int32_t p = 0; p < nprobe; p++) {
+    int32_t c = lists[p].second;
+    for (int64_t r = offsets_[c]; r < offsets_[c + 1]; r++) {
+      real s = utils::dotPadded(query, rows_ + r * stride_, stride_);
+      if (logZ != nullptr) {
+        if (s > max) {
+          sum = sum * std::exp(max - s) + 1.0;
+          max = s;
+        } else {
+          sum += std::exp(s - max);
+        }
+      }
+      if (int32_t(heap.size()) < k) {
+        heap.push(std::make_pair(s, ids_[r]));
+      } else if (s > heap.top().first) {
+        heap.pop();
+        heap.push(std::make_pair(s, ids_[r]));
+      }
+    }
+  }
+  results.resize(heap.size());
+  for (int64_t i = heap.size() - 1; i >= 0; i--) {
+    results[i] = heap.top();
+    heap.pop();
+  }
+  if (logZ != nullptr) {
+    *logZ = max + std::log(sum);
+  }
+}
+
+}
@@ -0,0 +1,65 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#ifndef FASTTEXT_IVFINDEX_H
+#define FASTTEXT_IVFINDEX_H
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "matrix.h"
+#include "real.h"
+
+namespace fasttext {
+
+// Inverted file index for maximum inner product search. Rows are split
+// into nlist lists by spherical k-means; a query only scans the rows of
+// the nprobe lists whose centroids score best, trading recall for speed.
+// The file keeps every section 64-byte aligned and is used in place from
+// a read-only mapping.
+class IvfIndex {
+  private:
+    static const int32_t MAGIC = 0x66766970; // "pivf"
+    static const int32_t VERSION = 1;
+    static const int64_t HEADER = 64;
+
+    void* map_;
+    int64_t mapSize_;
+    std::vector<char> buffer_; // file contents when it cannot be mapped
+    const real* centroids_;
+    const int64_t* offsets_;
+    const int32_t* ids_;
+    const real* rows_;
+
+    static int64_t aligned(int64_t);
+
+  public:
+    int64_t n_;
+    int64_t dim_;
+    int64_t stride_;
+    int64_t nlist_;
+    int32_t nprobe_; // default set when the index was built
+
+    IvfIndex();
+    IvfIndex(const IvfIndex&) = delete;
+    IvfIndex& operator=(const IvfIndex&) = delete;
+    ~IvfIndex();
+
+    static void build(const Matrix&, int64_t, int32_t, int32_t,
+                      const std::string&);
+    void load(const std::string&);
+    void search(const real*, int32_t, int32_t,
+                std::vector<std::pair<real, int32_t>>&, real* = nullptr) const;
+};
+
+}
+
+#endif
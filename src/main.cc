@@ -9,8 +9,11 @@
 
 #include <iostream>
 
+#include <thread>
+
 #include "fasttext.h"
 #include "args.h"
+#include "server.h"
 
 using namespace fasttext;
 
@@ -19,30 +22,54 @@ void printUsage() {
     << "usage: fasttext <command> <args>\n\n"
     << "The commands supported by fasttext are:\n\n"
     << "  supervised          train a supervised classifier\n"
+    << "  pwv-supervised      train a polarized embedding, then a classifier on it\n"
+    << "  autotune            search the hyperparameters of a supervised classifier\n"
+    << "  quantize            quantize a model to reduce the memory usage\n"
+    << "  prune               keep only the most important input rows of a model\n"
+    << "  index               build a nearest neighbor index of words or labels\n"
     << "  test                evaluate a supervised classifier\n"
+    << "  test-int8           compare a supervised classifier with its int8 copy\n"
     << "  predict             predict most likely labels\n"
     << "  predict-prob        predict most likely labels with probabilities\n"
+    << "  serve               keep a model loaded and answer predictions\n"
     << "  skipgram            train a skipgram model\n"
     << "  cbow                train a cbow model\n"
     << "  print-vectors       print vectors given a trained model\n"
+    << "  nn                  query for nearest neighbors\n"
+    << "  analogies           query for analogies\n"
     << std::endl;
 }
 
 void printTestUsage() {
   std::cout
-    << "usage: fasttext test <model> <test-data> [<k>]\n\n"
+    << "usage: fasttext test[-int8] <model> <test-data> [<k>] [<nprobe>]\n\n"
     << "  <model>      model filename\n"
     << "  <test-data>  test data filename (if -, read from stdin)\n"
     << "  <k>          (optional; 1 by default) predict top k labels\n"
+    << "  <nprobe>     (optional) lists scanned per query when an index was built\n"
     << std::endl;
 }
 
 void printPredictUsage() {
   std::cout
-    << "usage: fasttext predict[-prob] <model> <test-data> [<k>]\n\n"
+    << "usage: fasttext predict[-prob] <model> <test-data> [<k>] [<nprobe>]\n\n"
     << "  <model>      model filename\n"
     << "  <test-data>  test data filename (if -, read from stdin)\n"
     << "  <k>          (optional; 1 by default) predict top k labels\n"
+    << "  <nprobe>     (optional) lists scanned per query when an index was built\n"
+    << std::endl;
+}
+
+void printServeUsage() {
+  std::cout
+    << "usage: fasttext serve <model> <socket> [<k>] [<budget>] [<batch>]\n\n"
+    << "  <model>      model filename\n"
+    << "  <socket>     Unix domain socket path (if -, serve stdin and stdout)\n"
+    << "  <k>          (optional; 1 by default) predict top k labels\n"
+    << "  <budget>     (optional; 1000 by default) microseconds a request may wait for its batch\n"
+    << "  <batch>      (optional; 64 by default) most requests per batch\n\n"
+    << "Each line is answered with a line of labels and probabilities, or n/a.\n"
+    << "The line STATS is answered with request counts, queue depth and latencies.\n"
     << std::endl;
 }
 
@@ -53,46 +80,77 @@ void printPrintVectorsUsage() {
     << std::endl;
 }
 
+void printNNUsage() {
+  std::cout
+    << "usage: fasttext nn <model> [<k>] [<nprobe>]\n\n"
+    << "  <model>      model filename\n"
+    << "  <k>          (optional; 10 by default) number of neighbors\n"
+    << "  <nprobe>     (optional) lists scanned per query when an index was built\n"
+    << std::endl;
+}
+
+void printAnalogiesUsage() {
+  std::cout
+    << "usage: fasttext analogies <model> [<k>] [<nprobe>]\n\n"
+    << "  <model>      model filename\n"
+    << "  <k>          (optional; 10 by default) number of answers\n"
+    << "  <nprobe>     (optional) lists scanned per query when an index was built\n"
+    << std::endl;
+}
+
 void test(int argc, char** argv) {
-  int32_t k;
-  if (argc == 4) {
-    k = 1;
-  } else if (argc == 5) {
+  int32_t k = 1, nprobe = 0;
+  if (argc >= 5) {
     k = atoi(argv[4]);
-  } else {
+  }
+  if (argc == 6) {
+    nprobe = atoi(argv[5]);
+  } else if (argc < 4 || argc > 6) {
     printTestUsage();
     exit(EXIT_FAILURE);
   }
   FastText fasttext;
   fasttext.loadModel(std::string(argv[2]));
+  fasttext.loadIndexes(std::string(argv[2]), nprobe);
   std::string infile(argv[3]);
+  bool int8 = std::string(argv[1]) == "test-int8";
   if (infile == "-") {
-    fasttext.test(std::cin, k);
+    if (int8) {
+      fasttext.testInt8(std::cin, k);
+    } else {
+      fasttext.test(std::cin, k);
+    }
   } else {
     std::ifstream ifs(infile);
     if (!ifs.is_open()) {
       std::cerr << "Test file cannot be opened!" << std::endl;
       exit(EXIT_FAILURE);
     }
-    fasttext.test(ifs, k);
+    if (int8) {
+      fasttext.testInt8(ifs, k);
+    } else {
+      fasttext.test(ifs, k);
+    }
     ifs.close();
   }
   exit(0);
 }
 
 void predict(int argc, char** argv) {
-  int32_t k;
-  if (argc == 4) {
-    k = 1;
-  } else if (argc == 5) {
+  int32_t k = 1, nprobe = 0;
+  if (argc >= 5) {
     k = atoi(argv[4]);
-  } else {
+  }
+  if (argc == 6) {
+    nprobe = atoi(argv[5]);
+  } else if (argc < 4 || argc > 6) {
     printPredictUsage();
     exit(EXIT_FAILURE);
   }
   bool print_prob = std::string(argv[1]) == "predict-prob";
   FastText fasttext;
   fasttext.loadModel(std::string(argv[2]));
+  fasttext.loadIndexes(std::string(argv[2]), nprobe);
 
   std::string infile(argv[3]);
   if (infile == "-") {
@@ -110,6 +168,23 @@ void predict(int argc, char** argv) {
   exit(0);
 }
 
+void serve(int argc, char** argv) {
+  if (argc < 4 || argc > 7) {
+    printServeUsage();
+    exit(EXIT_FAILURE);
+  }
+  int32_t k = argc > 4 ? atoi(argv[4]) : 1;
+  int64_t budget = argc > 5 ? atol(argv[5]) : 1000;
+  int32_t batch = argc > 6 ? atoi(argv[6]) : 64;
+  FastText fasttext;
+  fasttext.loadModel(std::string(argv[2]));
+  fasttext.loadIndexes(std::string(argv[2]), 0);
+  int32_t threads = std::max(1u, std::thread::hardware_concurrency());
+  Server server(fasttext, k, budget, batch, threads);
+  server.run(std::string(argv[3]));
+  exit(0);
+}
+
 void printVectors(int argc, char** argv) {
   if (argc != 3) {
     printPrintVectorsUsage();
@@ -121,6 +196,81 @@ void printVectors(int argc, char** argv) {
   exit(0);
 }
 
+void nn(int argc, char** argv) {
+  int32_t k = 10, nprobe = 0;
+  if (argc >= 4) {
+    k = atoi(argv[3]);
+  }
+  if (argc == 5) {
+    nprobe = atoi(argv[4]);
+  } else if (argc < 3 || argc > 5) {
+    printNNUsage();
+    exit(EXIT_FAILURE);
+  }
+  FastText fasttext;
+  fasttext.loadModel(std::string(argv[2]));
+  fasttext.loadIndexes(std::string(argv[2]), nprobe);
+  fasttext.nn(k);
+  exit(0);
+}
+
+void analogies(int argc, char** argv) {
+  int32_t k = 10, nprobe = 0;
+  if (argc >= 4) {
+    k = atoi(argv[3]);
+  }
+  if (argc == 5) {
+    nprobe = atoi(argv[4]);
+  } else if (argc < 3 || argc > 5) {
+    printAnalogiesUsage();
+    exit(EXIT_FAILURE);
+  }
+  FastText fasttext;
+  fasttext.loadModel(std::string(argv[2]));
+  fasttext.loadIndexes(std::string(argv[2]), nprobe);
+  fasttext.analogies(k);
+  exit(0);
+}
+
+void quantize(int argc, char** argv) {
+  std::shared_ptr<Args> a = std::make_shared<Args>();
+  a->parseArgs(argc, argv);
+  FastText fasttext;
+  fasttext.quantize(a);
+  exit(0);
+}
+
+void prune(int argc, char** argv) {
+  std::shared_ptr<Args> a = std::make_shared<Args>();
+  a->parseArgs(argc, argv);
+  FastText fasttext;
+  fasttext.prune(a);
+  exit(0);
+}
+
+void index(int argc, char** argv) {
+  std::shared_ptr<Args> a = std::make_shared<Args>();
+  a->parseArgs(argc, argv);
+  FastText fasttext;
+  fasttext.index(a);
+  exit(0);
+}
+
+void autotune(int argc, char** argv) {
+  std::shared_ptr<Args> a = std::make_shared<Args>();
+  a->parseArgs(argc, argv);
+  FastText fasttext;
+  fasttext.autotune(a);
+  exit(0);
+}
+
+void pwvSupervised(int argc, char** argv) {
+  std::shared_ptr<Args> a = std::make_shared<Args>();
+  a->parseArgs(argc, argv);
+  FastText fasttext;
+  fasttext.pwvSupervised(a);
+}
+
 void train(int argc, char** argv) {
   std::shared_ptr<Args> a = std::make_shared<Args>();
   a->parseArgs(argc, argv);
@@ -136,12 +286,28 @@ int main(int argc, char** argv) {
   std::string command(argv[1]);
   if (command == "skipgram" || command == "cbow" || command == "supervised" || command == "pwv") {
     train(argc, argv);
-  } else if (command == "test") {
+  } else if (command == "pwv-supervised") {
+    pwvSupervised(argc, argv);
+  } else if (command == "autotune") {
+    autotune(argc, argv);
+  } else if (command == "quantize") {
+    quantize(argc, argv);
+  } else if (command == "prune") {
+    prune(argc, argv);
+  } else if (command == "index") {
+    index(argc, argv);
+  } else if (command == "test" || command == "test-int8") {
     test(argc, argv);
+  } else if (command == "nn") {
+    nn(argc, argv);
+  } else if (command == "analogies") {
+    analogies(argc, argv);
   } else if (command == "print-vectors") {
     printVectors(argc, argv);
   } else if (command == "predict" || command == "predict-prob" ) {
     predict(argc, argv);
+  } else if (command == "serve") {
+    serve(argc, argv);
   } else {
     printUsage();
     exit(EXIT_FAILURE);
@@ -10,67 +10,282 @@
 #include "matrix.h"
 
 #include <assert.h>
+#include <string.h>
 
+#include <algorithm>
 #include <random>
+#include <thread>
+#include <vector>
 
+#include "allocator.h"
+#include "half.h"
 #include "utils.h"
 #include "vector.h"
 
 namespace fasttext {
 
-Matrix::Matrix() {
+Matrix::Matrix() : Matrix(storage_type::fp32) {}
+
+Matrix::Matrix(storage_type storage) {
   m_ = 0;
   n_ = 0;
+  stride_ = 0;
+  lazy_ = 0;
+  kernels_ = &rowops::forDim(0);
+  storage_ = storage;
   data_ = nullptr;
+  hdata_ = nullptr;
+  slots_ = nullptr;
+  dirty_ = nullptr;
+  lazyValue_ = 0.0;
+  lazyUniform_ = false;
+  seed_ = 0;
 }
 
-Matrix::Matrix(int64_t m, int64_t n) {
+Matrix::Matrix(int64_t m, int64_t n, storage_type storage) {
   m_ = m;
   n_ = n;
-  data_ = new real[m * n];
+  lazy_ = m;
+  storage_ = storage;
+  slots_ = nullptr;
+  dirty_ = nullptr;
+  lazyValue_ = 0.0;
+  lazyUniform_ = false;
+  seed_ = 0;
+  allocate();
 }
 
 Matrix::Matrix(const Matrix& other) {
   m_ = other.m_;
   n_ = other.n_;
-  data_ = new real[m_ * n_];
-  for (int64_t i = 0; i < (m_ * n_); i++) {
-    data_[i] = other.data_[i];
+  lazy_ = other.lazy_;
+  storage_ = other.storage_;
+  slots_ = nullptr;
+  dirty_ = nullptr;
+  lazyValue_ = other.lazyValue_;
+  lazyUniform_ = other.lazyUniform_;
+  seed_ = other.seed_;
+  allocate(other.slots_ != nullptr);
+  // only the rows stored so far, the rest of a deferred block is untouched
+  int64_t rows = lazy_ + other.materialized();
+  memcpy(ptr(), other.ptr(), rows * stride_ * elementSize());
+  if (other.slots_ != nullptr) {
+    slots_ = new std::atomic<int64_t>[m_ - lazy_ + 1];
+    for (int64_t i = 0; i <= m_ - lazy_; i++) {
+      slots_[i].store(other.slots_[i].load());
+    }
   }
 }
 
 Matrix& Matrix::operator=(const Matrix& other) {
   Matrix temp(other);
-  m_ = temp.m_;
-  n_ = temp.n_;
+  std::swap(m_, temp.m_);
+  std::swap(n_, temp.n_);
+  std::swap(stride_, temp.stride_);
+  std::swap(kernels_, temp.kernels_);
+  std::swap(lazy_, temp.lazy_);
+  std::swap(storage_, temp.storage_);
   std::swap(data_, temp.data_);
+  std::swap(hdata_, temp.hdata_);
+  std::swap(slots_, temp.slots_);
+  std::swap(dirty_, temp.dirty_);
+  std::swap(lazyValue_, temp.lazyValue_);
+  std::swap(lazyUniform_, temp.lazyUniform_);
+  std::swap(seed_, temp.seed_);
   return *this;
 }
 
 Matrix::~Matrix() {
-  delete[] data_;
+  allocator::deallocate(ptr(), bytes());
+  delete[] slots_;
+  delete[] dirty_;
+}
+
+int64_t Matrix::elementSize() const {
+  return storage_ == storage_type::fp32 ? sizeof(real) : sizeof(uint16_t);
+}
+
+void Matrix::allocate(bool sparse) {
+  data_ = nullptr;
+  hdata_ = nullptr;
+  stride_ = allocator::padded(n_, elementSize());
+  kernels_ = &rowops::forDim(n_);
+  if (storage_ == storage_type::fp32) {
+    data_ = (real*) allocator::allocate(bytes(), sparse);
+  } else {
+    hdata_ = (uint16_t*) allocator::allocate(bytes(), sparse);
+  }
+}
+
+void* Matrix::ptr() const {
+  return storage_ == storage_type::fp32 ? (void*) data_ : (void*) hdata_;
+}
+
+int64_t Matrix::bytes() const {
+  return m_ * stride_ * elementSize();
 }
 
 void Matrix::zero() {
-  for (int64_t i = 0; i < (m_ * n_); i++) {
-      data_[i] = 0.0;
+  // all-zero bits are 0.0 in every storage type
+  memset(ptr(), 0, bytes());
+}
+
+// Rows are split in contiguous blocks, one per thread, and written in
+// place; deferred rows are left to their first touch.
+void Matrix::uniform(real a, int32_t seed, int32_t threads) {
+  int64_t rows = lazy_;
+  threads = std::max<int64_t>(1, std::min<int64_t>(threads, rows / 1024));
+  auto fill = [=](int64_t begin, int64_t end) {
+    std::vector<real> row(storage_ == storage_type::fp32 ? 0 : n_);
+    for (int64_t i = begin; i < end; i++) {
+      if (storage_ == storage_type::fp32) {
+        uniformRow(i, a, seed, data_ + i * stride_);
+      } else {
+        uniformRow(i, a, seed, row.data());
+        writeRow(i * stride_, row.data());
+      }
+    }
+  };
+  std::vector<std::thread> workers;
+  for (int32_t t = 1; t < threads; t++) {
+    workers.push_back(std::thread(fill, t * rows / threads, (t + 1) * rows / threads));
+  }
+  fill(0, rows / threads);
+  for (auto& w : workers) {
+    w.join();
+  }
+}
+
+// Every row draws from its own stream, seeded from the row index, so rows
+// can be initialized in any order and by any thread, eagerly or on first
+// touch, and still give the same matrix for a given seed.
+void Matrix::uniformRow(int64_t i, real a, int32_t seed, real* row) const {
+  uint64_t z = (uint64_t(uint32_t(seed)) << 40) + uint64_t(i) + 0x9e3779b97f4a7c15ULL;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  z ^= z >> 31;
+  std::minstd_rand rng(1 + z % 2147483646);
+  std::uniform_real_distribution<real> uniform(-a, a);
+  for (int64_t j = 0; j < n_; j++) {
+    row[j] = uniform(rng);
+  }
+}
+
+// Rows from begin on are only stored the first time they are touched,
+// packed one after the other. Hash buckets are mostly never hit, so the
+// block is mapped sparse and only the stored prefix takes memory.
+void Matrix::defer(int64_t begin) {
+  assert(begin >= 0 && begin <= m_);
+  allocator::deallocate(ptr(), bytes());
+  allocate(true);
+  delete[] slots_;
+  lazy_ = begin;
+  slots_ = new std::atomic<int64_t>[m_ - lazy_ + 1];
+  for (int64_t i = 0; i < m_ - lazy_; i++) {
+    slots_[i].store(UNTOUCHED, std::memory_order_relaxed);
+  }
+  slots_[m_ - lazy_].store(0);
+}
+
+void Matrix::deferUniform(int64_t begin, real a, int32_t seed) {
+  defer(begin);
+  lazyUniform_ = true;
+  lazyValue_ = a;
+  seed_ = seed;
+}
+
+void Matrix::deferConstant(int64_t begin, real c) {
+  defer(begin);
+  lazyUniform_ = false;
+  lazyValue_ = c;
+}
+
+void Matrix::initRow(int64_t i, real* row) const {
+  if (lazyUniform_) {
+    uniformRow(i, lazyValue_, seed_, row);
+  } else {
+    std::fill(row, row + n_, lazyValue_);
+  }
+}
+
+// the first thread to touch a row stores it, the others wait for it
+int64_t Matrix::materialize(int64_t i) const {
+  std::atomic<int64_t>& slot = slots_[i - lazy_];
+  int64_t expected = UNTOUCHED;
+  if (slot.compare_exchange_strong(expected, BUSY, std::memory_order_acquire)) {
+    int64_t s = slots_[m_ - lazy_].fetch_add(1);
+    static thread_local std::vector<real> row;
+    row.resize(n_);
+    initRow(i, row.data());
+    writeRow((lazy_ + s) * stride_, row.data());
+    slot.store(s, std::memory_order_release);
+    return s;
+  }
+  while ((expected = slot.load(std::memory_order_acquire)) == BUSY) {
+    std::this_thread::yield();
   }
+  return expected;
 }
 
-void Matrix::uniform(real a) {
-  std::minstd_rand rng(1);
-  std::uniform_real_distribution<> uniform(-a, a);
-  for (int64_t i = 0; i < (m_ * n_); i++) {
-    data_[i] = uniform(rng);
+// element offset of row i, or -1 if it was deferred and never touched
+int64_t Matrix::stored(int64_t i) const {
+  if (i < lazy_) return i * stride_;
+  int64_t slot = slots_[i - lazy_].load(std::memory_order_acquire);
+  while (slot == BUSY) {
+    std::this_thread::yield();
+    slot = slots_[i - lazy_].load(std::memory_order_acquire);
   }
+  return slot < 0 ? -1 : (lazy_ + slot) * stride_;
+}
+
+// from now on addRow flags the rows it changes
+void Matrix::trackDirty() {
+  delete[] dirty_;
+  dirty_ = new uint8_t[m_]();
+}
+
+// the rows changed since the last call; like hogwild, a row changed while
+// this runs may go unreported until it changes again
+void Matrix::takeDirty(std::vector<int64_t>& rows) {
+  rows.clear();
+  for (int64_t i = 0; i < m_; i++) {
+    if (dirty_[i]) {
+      dirty_[i] = 0;
+      rows.push_back(i);
+    }
+  }
+}
+
+// number of deferred rows stored so far
+int64_t Matrix::materialized() const {
+  return slots_ == nullptr ? 0 : slots_[m_ - lazy_].load();
 }
 
 void Matrix::addRow(const Vector& vec, int64_t i, real a) {
   assert(i >= 0);
   assert(i < m_);
   assert(vec.m_ == n_);
+  int64_t k = offset(i);
+  if (dirty_ != nullptr) dirty_[i] = 1;
+  if (storage_ == storage_type::fp32) {
+    kernels_->axpy(data_ + k, vec.data_, a, n_);
+    return;
+  }
+  uint16_t* row = hdata_ + k;
+  if (storage_ == storage_type::bf16) {
+    // bf16 keeps 8 bits of mantissa, too few for round-to-nearest to
+    // register small learning-rate steps
+    static thread_local uint32_t noise = 2463534242u;
+    for (int64_t j = 0; j < n_; j++) {
+      noise ^= noise << 13;
+      noise ^= noise >> 17;
+      noise ^= noise << 5;
+      row[j] = half::realToBf16(half::bf16ToReal(row[j]) + a * vec.data_[j], noise);
+    }
+    return;
+  }
   for (int64_t j = 0; j < n_; j++) {
-    data_[i * n_ + j] += a * vec.data_[j];
+    row[j] = half::fromReal(half::toReal(row[j], storage_) + a * vec.data_[j], storage_);
   }
 }
 
@@ -78,25 +293,99 @@ real Matrix::dotRow(const Vector& vec, int64_t i) {
   assert(i >= 0);
   assert(i < m_);
   assert(vec.m_ == n_);
+  int64_t k = offset(i);
   real d = 0.0;
+  if (storage_ == storage_type::fp32) {
+    return kernels_->dot(data_ + k, vec.data_, n_);
+  }
+  const uint16_t* row = hdata_ + k;
   for (int64_t j = 0; j < n_; j++) {
-    d += data_[i * n_ + j] * vec.data_[j];
+    d += half::toReal(row[j], storage_) * vec.data_[j];
   }
   return d;
 }
 
+// untouched rows are computed without being written
+void Matrix::getRow(int64_t i, real* out) const {
+  assert(i >= 0);
+  assert(i < m_);
+  int64_t k = stored(i);
+  if (k < 0) {
+    initRow(i, out);
+    return;
+  }
+  if (storage_ == storage_type::fp32) {
+    memcpy(out, data_ + k, n_ * sizeof(real));
+    return;
+  }
+  const uint16_t* row = hdata_ + k;
+  for (int64_t j = 0; j < n_; j++) {
+    out[j] = half::toReal(row[j], storage_);
+  }
+}
+
+void Matrix::setRow(int64_t i, const real* in) {
+  assert(i >= 0);
+  assert(i < m_);
+  writeRow(offset(i), in);
+}
+
+// k is the element offset of the row
+void Matrix::writeRow(int64_t k, const real* in) const {
+  if (storage_ == storage_type::fp32) {
+    memcpy(data_ + k, in, n_ * sizeof(real));
+    return;
+  }
+  uint16_t* row = hdata_ + k;
+  for (int64_t j = 0; j < n_; j++) {
+    row[j] = half::fromReal(in[j], storage_);
+  }
+}
+
+int64_t Matrix::hugePages() const {
+  return allocator::hugePages(ptr(), bytes());
+}
+
+// rows are written unpadded, in the storage type of the matrix; rows
+// never touched are written with the value they would have been given
 void Matrix::save(std::ostream& out) {
   out.write((char*) &m_, sizeof(int64_t));
   out.write((char*) &n_, sizeof(int64_t));
-  out.write((char*) data_, m_ * n_ * sizeof(real));
+  int64_t size = elementSize();
+  std::vector<real> row(n_);
+  std::vector<uint16_t> hrow(n_);
+  for (int64_t i = 0; i < m_; i++) {
+    int64_t k = stored(i);
+    if (k >= 0) {
+      out.write((char*) ptr() + k * size, n_ * size);
+      continue;
+    }
+    initRow(i, row.data());
+    if (storage_ == storage_type::fp32) {
+      out.write((char*) row.data(), n_ * size);
+      continue;
+    }
+    for (int64_t j = 0; j < n_; j++) {
+      hrow[j] = half::fromReal(row[j], storage_);
+    }
+    out.write((char*) hrow.data(), n_ * size);
+  }
 }
 
 void Matrix::load(std::istream& in) {
+  allocator::deallocate(ptr(), bytes());
   in.read((char*) &m_, sizeof(int64_t));
   in.read((char*) &n_, sizeof(int64_t));
-  delete[] data_;
-  data_ = new real[m_ * n_];
-  in.read((char*) data_, m_ * n_ * sizeof(real));
+  delete[] slots_;
+  slots_ = nullptr;
+  delete[] dirty_;
+  dirty_ = nullptr;
+  lazy_ = m_;
+  allocate();
+  int64_t size = elementSize();
+  for (int64_t i = 0; i < m_; i++) {
+    in.read((char*) ptr() + i * stride_ * size, n_ * size);
+  }
 }
 
 }
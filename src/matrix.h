@@ -10,10 +10,13 @@
 #ifndef FASTTEXT_MATRIX_H
 #define FASTTEXT_MATRIX_H
 
+#include <atomic>
 #include <cstdint>
 #include <istream>
 #include <ostream>
+#include <vector>
 
+#include "rowops.h"
 #include "real.h"
 
 namespace fasttext {
@@ -23,23 +26,68 @@ class Vector;
 class Matrix {
 
   public:
-    real* data_;
+    real* data_;     // rows when storage_ is fp32
+    uint16_t* hdata_; // rows when storage_ is fp16 or bf16
+    storage_type storage_;
     int64_t m_;
     int64_t n_;
+    int64_t stride_; // row length in memory, padded for SIMD
+    int64_t lazy_;   // rows from here on are stored on first touch
+    const rowops::Row* kernels_; // loops over fp32 rows of n_
 
     Matrix();
-    Matrix(int64_t, int64_t);
+    explicit Matrix(storage_type);
+    Matrix(int64_t, int64_t, storage_type = storage_type::fp32);
     Matrix(const Matrix&);
     Matrix& operator=(const Matrix&);
     ~Matrix();
 
     void zero();
-    void uniform(real);
+    void uniform(real, int32_t = 0, int32_t = 1);
+    void deferUniform(int64_t, real, int32_t = 0);
+    void deferConstant(int64_t, real);
+    int64_t materialized() const;
+    void trackDirty();
+    void takeDirty(std::vector<int64_t>&);
     real dotRow(const Vector&, int64_t);
     void addRow(const Vector&, int64_t, real);
+    void getRow(int64_t, real*) const;
+    void setRow(int64_t, const real*);
+    void* ptr() const;
+    int64_t bytes() const;
+    int64_t hugePages() const;
 
     void save(std::ostream&);
     void load(std::istream&);
+
+    // element offset of row i, storing it first if it was deferred
+    int64_t offset(int64_t i) const {
+      if (i < lazy_) return i * stride_;
+      int64_t slot = slots_[i - lazy_].load(std::memory_order_acquire);
+      if (slot < 0) slot = materialize(i);
+      return (lazy_ + slot) * stride_;
+    }
+
+  private:
+    static const int64_t UNTOUCHED = -1;
+    static const int64_t BUSY = -2;
+
+    // where each deferred row is stored, in the order rows were first
+    // touched; the extra last entry counts the slots handed out
+    std::atomic<int64_t>* slots_;
+    uint8_t* dirty_; // rows changed by addRow, when tracked
+    real lazyValue_;
+    bool lazyUniform_;
+    int32_t seed_;
+
+    int64_t elementSize() const;
+    void allocate(bool = false);
+    void defer(int64_t);
+    void initRow(int64_t, real*) const;
+    void uniformRow(int64_t, real, int32_t, real*) const;
+    void writeRow(int64_t, const real*) const;
+    int64_t stored(int64_t) const;
+    int64_t materialize(int64_t) const;
 };
 
 }
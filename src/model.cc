@@ -29,6 +29,9 @@ Model::Model(std::shared_ptr<Matrix> wi,
   isz_ = wi->m_;
   osz_ = wo->m_;
   hsz_ = args->dim;
+  quant_ = false;
+  nprobe_ = 0;
+  qout_ = false;
   negpos = 0;
   loss_ = 0.0;
   nexamples_ = 1;
@@ -91,7 +94,13 @@ real Model::hierarchicalSoftmax(int32_t target, real lr) {
 }
 
 void Model::computeOutputSoftmax(Vector& hidden, Vector& output) const {
-  output.mul(*wo_, hidden);
+  if (qout_) {
+    qwo_->mulAll(hidden, output);
+  } else if (iwo_) {
+    iwo_->mulAll(hidden, output);
+  } else {
+    output.mul(*wo_, hidden);
+  }
   real max = output[0], z = 0.0;
   for (int32_t i = 0; i < osz_; i++) {
     max = std::max(output[i], max);
@@ -125,7 +134,13 @@ void Model::computeHidden(const std::vector<int32_t>& input, Vector& hidden) con
   assert(hidden.size() == hsz_);
   hidden.zero();
   for (auto it = input.cbegin(); it != input.cend(); ++it) {
-    hidden.addRow(*wi_, *it);
+    if (quant_) {
+      qwi_->addToVector(hidden, *it);
+    } else if (iwi_) {
+      iwi_->addToVector(hidden, *it);
+    } else {
+      hidden.addRow(*wi_, *it);
+    }
   }
   hidden.mul(1.0 / input.size());
 }
@@ -143,6 +158,8 @@ void Model::predict(const std::vector<int32_t>& input, int32_t k,
   computeHidden(input, hidden);
   if (args_->loss == loss_name::hs) {
     dfs(k, 2 * osz_ - 2, 0.0, heap, hidden);
+  } else if (labelIndex_) {
+    findKBestIndexed(k, heap, hidden);
   } else {
     findKBest(k, heap, hidden, output);
   }
@@ -170,6 +187,19 @@ void Model::findKBest(int32_t k, std::vector<std::pair<real, int32_t>>& heap,
   }
 }
 
+// Scores only the labels in the lists the index probes; the softmax is
+// normalized over those labels, which hold nearly all of its mass.
+void Model::findKBestIndexed(int32_t k, std::vector<std::pair<real, int32_t>>& heap,
+                             Vector& hidden) const {
+  std::vector<std::pair<real, int32_t>> found;
+  real logZ;
+  labelIndex_->search(hidden.data_, k, nprobe_, found, &logZ);
+  for (auto it = found.cbegin(); it != found.cend(); it++) {
+    heap.push_back(std::make_pair(it->first - logZ, it->second));
+    std::push_heap(heap.begin(), heap.end(), comparePairs);
+  }
+}
+
 void Model::dfs(int32_t k, int32_t node, real score,
                 std::vector<std::pair<real, int32_t>>& heap,
                 Vector& hidden) const {
@@ -187,7 +217,15 @@ void Model::dfs(int32_t k, int32_t node, real score,
     return;
   }
 
-  real f = sigmoid(wo_->dotRow(hidden, node - osz_));
+  real f;
+  if (qout_) {
+    f = qwo_->dotRow(hidden, node - osz_);
+  } else if (iwo_) {
+    f = iwo_->dotRow(hidden, node - osz_);
+  } else {
+    f = wo_->dotRow(hidden, node - osz_);
+  }
+  f = sigmoid(f);
   dfs(k, tree[node].left, score + log(1.0 - f), heap, hidden);
   dfs(k, tree[node].right, score + log(f), heap, hidden);
 }
@@ -224,6 +262,31 @@ void Model::updatePolarization(int32_t w, real lr) {
   wi_->addRow(grad_, w, 1.0);
 }
 
+// predict from product-quantized matrices; qwo may be null when the
+// output matrix was kept in full
+void Model::setQuantizePointer(std::shared_ptr<QMatrix> qwi,
+                               std::shared_ptr<QMatrix> qwo) {
+  qwi_ = qwi;
+  qwo_ = qwo;
+  quant_ = qwi_ != nullptr;
+  qout_ = qwo_ != nullptr;
+  if (qout_) {
+    osz_ = qwo_->m_;
+  }
+}
+
+// inference-only int8 copies of the matrices; training still needs wi_/wo_
+void Model::setInt8Pointer(std::shared_ptr<Int8Matrix> iwi,
+                           std::shared_ptr<Int8Matrix> iwo) {
+  iwi_ = iwi;
+  iwo_ = iwo;
+}
+
+void Model::setLabelIndex(std::shared_ptr<IvfIndex> index, int32_t nprobe) {
+  labelIndex_ = index;
+  nprobe_ = nprobe;
+}
+
 void Model::setTargetCounts(const std::vector<int64_t>& counts) {
   assert(counts.size() == osz_);
  // init negative table for both ns and polar (ddu)  
@@ -17,6 +17,9 @@
 
 #include "args.h"
 #include "matrix.h"
+#include "qmatrix.h"
+#include "int8matrix.h"
+#include "ivfindex.h"
 #include "vector.h"
 #include "real.h"
 
@@ -38,6 +41,14 @@ class Model {
   private:
     std::shared_ptr<Matrix> wi_;
     std::shared_ptr<Matrix> wo_;
+    std::shared_ptr<QMatrix> qwi_;
+    std::shared_ptr<QMatrix> qwo_;
+    std::shared_ptr<Int8Matrix> iwi_;
+    std::shared_ptr<Int8Matrix> iwo_;
+    std::shared_ptr<IvfIndex> labelIndex_;
+    int32_t nprobe_;
+    bool quant_;
+    bool qout_;
     std::shared_ptr<Args> args_;
     Vector hidden_;
     std::vector<int32_t> hidden_labels_; // labels of the hidden word      
@@ -87,11 +98,16 @@ class Model {
              Vector&) const;
     void findKBest(int32_t, std::vector<std::pair<real, int32_t>>&,
                    Vector&, Vector&) const;
+    void findKBestIndexed(int32_t, std::vector<std::pair<real, int32_t>>&,
+                          Vector&) const;
     void update(const std::vector<int32_t>&, int32_t, real);
     void computeHidden(const std::vector<int32_t>&, Vector&) const;
     void computeOutputSoftmax(Vector&, Vector&) const;
     void computeOutputSoftmax();
 
+    void setQuantizePointer(std::shared_ptr<QMatrix>, std::shared_ptr<QMatrix>);
+    void setInt8Pointer(std::shared_ptr<Int8Matrix>, std::shared_ptr<Int8Matrix>);
+    void setLabelIndex(std::shared_ptr<IvfIndex>, int32_t);
     void setTargetCounts(const std::vector<int64_t>&);
     void initTableNegatives(const std::vector<int64_t>&);
     void buildTree(const std::vector<int64_t>&);
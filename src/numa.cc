@@ -0,0 +1,116 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include "numa.h"
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace fasttext {
+
+namespace numa {
+
+#ifdef __linux__
+  // from <numaif.h>; spelled out so we do not need to link libnuma
+  const int MPOL_BIND = 2;
+  const int MPOL_INTERLEAVE = 3;
+
+  // parse a sysfs list such as "0-3,8-11"
+  std::vector<int32_t> readList(const std::string& path) {
+    std::vector<int32_t> ids;
+    std::ifstream ifs(path);
+    std::string range;
+    while (std::getline(ifs, range, ',')) {
+      size_t dash = range.find('-');
+      int32_t lo = std::stoi(range);
+      int32_t hi = dash == std::string::npos ? lo : std::stoi(range.substr(dash + 1));
+      for (int32_t i = lo; i <= hi; i++) {
+        ids.push_back(i);
+      }
+    }
+    return ids;
+  }
+
+  void setPolicy(void* ptr, size_t size, int mode, unsigned long mask) {
+    size_t page = sysconf(_SC_PAGESIZE);
+    uintptr_t begin = (uintptr_t(ptr) + page - 1) / page * page;
+    uintptr_t end = (uintptr_t(ptr) + size) / page * page;
+    if (end <= begin) return;
+    syscall(SYS_mbind, begin, end - begin, mode, &mask, sizeof(mask) * 8, 0);
+  }
+#endif
+
+  int32_t nodes() {
+#ifdef __linux__
+    static int32_t n = [] {
+      std::vector<int32_t> ids = readList("/sys/devices/system/node/online");
+      // masks below are a single word, which covers any machine we run on
+      return ids.empty() ? 1 : std::min(int32_t(ids.back() + 1), int32_t(63));
+    }();
+    return n;
+#else
+    return 1;
+#endif
+  }
+
+  // spread threads over the nodes in contiguous blocks
+  int32_t nodeOf(int32_t threadId, int32_t nthreads) {
+    return int64_t(threadId) * nodes() / nthreads;
+  }
+
+  bool pinThread(int32_t node) {
+#ifdef __linux__
+    std::vector<int32_t> cpus = readList(
+      "/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+    if (cpus.empty()) return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (auto cpu : cpus) {
+      CPU_SET(cpu, &set);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+  }
+
+  // the policies only take effect on first touch, so call these right
+  // after allocation and before the memory is initialized
+  void interleave(void* ptr, size_t size) {
+#ifdef __linux__
+    if (nodes() < 2) return;
+    setPolicy(ptr, size, MPOL_INTERLEAVE, (1UL << nodes()) - 1);
+#endif
+  }
+
+  void partition(void* ptr, size_t size) {
+    int32_t n = nodes();
+    for (int32_t i = 0; i < n; i++) {
+      bind((char*) ptr + i * size / n, (i + 1) * size / n - i * size / n, i);
+    }
+  }
+
+  void bind(void* ptr, size_t size, int32_t node) {
+#ifdef __linux__
+    if (nodes() < 2) return;
+    setPolicy(ptr, size, MPOL_BIND, 1UL << node);
+#endif
+  }
+}
+
+}
@@ -0,0 +1,30 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#ifndef FASTTEXT_NUMA_H
+#define FASTTEXT_NUMA_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace fasttext {
+
+namespace numa {
+
+  int32_t nodes();
+  int32_t nodeOf(int32_t, int32_t);
+  bool pinThread(int32_t);
+  void interleave(void*, size_t);
+  void partition(void*, size_t);
+  void bind(void*, size_t, int32_t);
+}
+
+}
+
+#endif
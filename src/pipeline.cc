@@ -0,0 +1,143 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include "pipeline.h"
+
+#include <iomanip>
+#include <thread>
+
+namespace fasttext {
+
+const int64_t Pipeline::BATCH_WORDS;
+const int32_t Pipeline::BATCHES_PER_THREAD;
+
+void LineBatch::clear() {
+  words.clear();
+  labels.clear();
+  wordEnd.clear();
+  labelEnd.clear();
+  ntokens.clear();
+}
+
+void LineBatch::add(const std::vector<int32_t>& line,
+                    const std::vector<int32_t>& lineLabels, int32_t n) {
+  words.insert(words.end(), line.begin(), line.end());
+  labels.insert(labels.end(), lineLabels.begin(), lineLabels.end());
+  wordEnd.push_back(words.size());
+  labelEnd.push_back(labels.size());
+  ntokens.push_back(n);
+}
+
+void LineBatch::get(int64_t i, std::vector<int32_t>& line,
+                    std::vector<int32_t>& lineLabels) const {
+  int64_t w = i > 0 ? wordEnd[i - 1] : 0;
+  int64_t l = i > 0 ? labelEnd[i - 1] : 0;
+  line.assign(words.begin() + w, words.begin() + wordEnd[i]);
+  lineLabels.assign(labels.begin() + l, labels.begin() + labelEnd[i]);
+}
+
+int64_t LineBatch::size() const {
+  return ntokens.size();
+}
+
+Pipeline::Pipeline(int32_t producers, int32_t consumers)
+  : full_((producers + consumers) * BATCHES_PER_THREAD),
+    free_((producers + consumers) * BATCHES_PER_THREAD),
+    producers_(producers), start_(clock::now()) {
+  threads_[tokenize] = producers;
+  threads_[train] = consumers;
+  for (int32_t s = 0; s < 2; s++) {
+    wait_[s] = 0;
+    alive_[s] = 0;
+  }
+  for (int32_t i = 0; i < (producers + consumers) * BATCHES_PER_THREAD; i++) {
+    batches_.push_back(std::unique_ptr<LineBatch>(new LineBatch()));
+    free_.push(batches_.back().get());
+  }
+}
+
+// spin briefly, then yield, then sleep, so waiting threads do not take
+// the cores of the stage they wait for
+void Pipeline::backoff(int32_t& spins) const {
+  if (++spins < 64) return;
+  if (spins < 128) {
+    std::this_thread::yield();
+  } else {
+    std::this_thread::sleep_for(std::chrono::microseconds(50));
+  }
+}
+
+int64_t Pipeline::since(clock::time_point t) const {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      clock::now() - t).count();
+}
+
+// an empty batch for a tokenizer, waiting until a trainer gives one back
+LineBatch* Pipeline::acquire() {
+  LineBatch* batch;
+  if (free_.pop(batch)) return batch;
+  clock::time_point t = clock::now();
+  int32_t spins = 0;
+  while (!free_.pop(batch)) {
+    backoff(spins);
+  }
+  wait_[tokenize] += since(t);
+  return batch;
+}
+
+// never blocks: there are no more batches than the queue holds
+void Pipeline::publish(LineBatch* batch) {
+  full_.push(batch);
+}
+
+void Pipeline::done() {
+  alive_[tokenize] += since(start_);
+  producers_--;
+}
+
+// the next full batch for a trainer, or nullptr once every tokenizer is
+// done and the queue is drained
+LineBatch* Pipeline::next() {
+  LineBatch* batch;
+  if (full_.pop(batch)) return batch;
+  clock::time_point t = clock::now();
+  int32_t spins = 0;
+  while (!full_.pop(batch)) {
+    if (producers_.load() == 0) {
+      // a batch published before the last done() is visible by now
+      if (full_.pop(batch)) break;
+      wait_[train] += since(t);
+      alive_[train] += since(start_);
+      return nullptr;
+    }
+    backoff(spins);
+  }
+  wait_[train] += since(t);
+  return batch;
+}
+
+void Pipeline::release(LineBatch* batch) {
+  batch->clear();
+  free_.push(batch);
+}
+
+void Pipeline::report(std::ostream& out) const {
+  const char* names[2] = {"Tokenizers", "Trainers"};
+  const char* waits[2] = {"waiting for the trainers", "waiting for batches"};
+  out << std::fixed << std::setprecision(1);
+  for (int32_t s = 0; s < 2; s++) {
+    double alive = alive_[s].load();
+    double wait = alive > 0 ? 100.0 * wait_[s].load() / alive : 0.0;
+    out << names[s] << " (" << threads_[s] << "): " << 100.0 - wait
+        << "% busy, " << wait << "% " << waits[s] << std::endl;
+  }
+  out.unsetf(std::ios::floatfield);
+}
+
+}
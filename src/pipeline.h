@@ -0,0 +1,144 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#ifndef FASTTEXT_PIPELINE_H
+#define FASTTEXT_PIPELINE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+namespace fasttext {
+
+// Bounded multi-producer multi-consumer queue without locks (Vyukov):
+// every cell carries a sequence number telling whether it is free for the
+// producer or filled for the consumer of the current lap.
+template <typename T>
+class BoundedQueue {
+  private:
+    struct Cell {
+      std::atomic<size_t> seq;
+      T data;
+    };
+
+    std::unique_ptr<Cell[]> cells_;
+    size_t mask_;
+    alignas(64) std::atomic<size_t> head_;
+    alignas(64) std::atomic<size_t> tail_;
+
+  public:
+    // capacity is rounded up to a power of two
+    explicit BoundedQueue(size_t capacity) : head_(0), tail_(0) {
+      size_t n = 2;
+      while (n < capacity) n <<= 1;
+      cells_.reset(new Cell[n]);
+      mask_ = n - 1;
+      for (size_t i = 0; i < n; i++) {
+        cells_[i].seq.store(i, std::memory_order_relaxed);
+      }
+    }
+
+    bool push(const T& data) {
+      size_t pos = head_.load(std::memory_order_relaxed);
+      while (true) {
+        Cell& cell = cells_[pos & mask_];
+        size_t seq = cell.seq.load(std::memory_order_acquire);
+        intptr_t diff = intptr_t(seq) - intptr_t(pos);
+        if (diff == 0) {
+          if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+            cell.data = data;
+            cell.seq.store(pos + 1, std::memory_order_release);
+            return true;
+          }
+        } else if (diff < 0) {
+          return false;
+        } else {
+          pos = head_.load(std::memory_order_relaxed);
+        }
+      }
+    }
+
+    bool pop(T& data) {
+      size_t pos = tail_.load(std::memory_order_relaxed);
+      while (true) {
+        Cell& cell = cells_[pos & mask_];
+        size_t seq = cell.seq.load(std::memory_order_acquire);
+        intptr_t diff = intptr_t(seq) - intptr_t(pos + 1);
+        if (diff == 0) {
+          if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+            data = cell.data;
+            cell.seq.store(pos + mask_ + 1, std::memory_order_release);
+            return true;
+          }
+        } else if (diff < 0) {
+          return false;
+        } else {
+          pos = tail_.load(std::memory_order_relaxed);
+        }
+      }
+    }
+};
+
+// tokenized lines, back to back, ready for training
+struct LineBatch {
+  std::vector<int32_t> words;
+  std::vector<int32_t> labels;
+  std::vector<int64_t> wordEnd;
+  std::vector<int64_t> labelEnd;
+  std::vector<int32_t> ntokens; // as counted by getLine, for the progress
+
+  void clear();
+  void add(const std::vector<int32_t>&, const std::vector<int32_t>&, int32_t);
+  void get(int64_t, std::vector<int32_t>&, std::vector<int32_t>&) const;
+  int64_t size() const;
+};
+
+// Tokenizer threads fill batches taken from a free list and publish them;
+// trainer threads consume them and give them back. The fixed number of
+// batches bounds the memory and makes fast tokenizers wait for the
+// trainers. Waits are timed so each stage's utilization can be reported.
+class Pipeline {
+  public:
+    enum stage { tokenize = 0, train = 1 };
+
+    static const int64_t BATCH_WORDS = 8192;
+    static const int32_t BATCHES_PER_THREAD = 4;
+
+  private:
+    typedef std::chrono::steady_clock clock;
+
+    std::vector<std::unique_ptr<LineBatch>> batches_;
+    BoundedQueue<LineBatch*> full_;
+    BoundedQueue<LineBatch*> free_;
+    std::atomic<int32_t> producers_;
+    int32_t threads_[2];
+    std::atomic<int64_t> wait_[2];  // nanoseconds spent blocked
+    std::atomic<int64_t> alive_[2]; // nanoseconds from start to finish
+    clock::time_point start_;
+
+    void backoff(int32_t&) const;
+    int64_t since(clock::time_point) const;
+
+  public:
+    Pipeline(int32_t, int32_t);
+
+    LineBatch* acquire();
+    void publish(LineBatch*);
+    void done();
+    LineBatch* next();
+    void release(LineBatch*);
+    void report(std::ostream&) const;
+};
+
+}
+
+#endif
@@ -0,0 +1,96 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include "polarizedtext.h"
+
+#include <cmath>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "fasttext.h"
+
+using namespace fasttext;
+
+struct pt_model {
+  FastText fasttext;
+  std::vector<std::string> labels;
+};
+
+struct pt_workspace {
+  Vector hidden;
+  Vector output;
+  std::minstd_rand rng;
+  std::vector<std::pair<real, int32_t>> predictions;
+
+  pt_workspace(int64_t dim, int64_t nlabels)
+    : hidden(dim), output(nlabels) {}
+};
+
+pt_model* pt_load(const char* filename) {
+  if (!std::ifstream(filename).good()) return nullptr;
+  pt_model* model = new pt_model();
+  model->fasttext.loadModel(std::string(filename));
+  model->fasttext.loadIndexes(std::string(filename), 0);
+  auto dict = model->fasttext.getDictionary();
+  for (int32_t i = 0; i < dict->nlabels(); i++) {
+    model->labels.push_back(dict->getLabel(i));
+  }
+  return model;
+}
+
+void pt_free(pt_model* model) {
+  delete model;
+}
+
+int pt_dimension(const pt_model* model) {
+  return model->fasttext.getArgs()->dim;
+}
+
+int pt_nlabels(const pt_model* model) {
+  return model->labels.size();
+}
+
+const char* pt_label(const pt_model* model, int id) {
+  if (id < 0 || id >= int(model->labels.size())) return nullptr;
+  return model->labels[id].c_str();
+}
+
+pt_workspace* pt_workspace_new(const pt_model* model) {
+  return new pt_workspace(pt_dimension(model), pt_nlabels(model));
+}
+
+void pt_workspace_free(pt_workspace* workspace) {
+  delete workspace;
+}
+
+int pt_predict(const pt_model* model, pt_workspace* workspace,
+               const char* text, int k, int* labels, float* probs) {
+  if (k <= 0) return 0;
+  std::istringstream iss(text);
+  model->fasttext.predict(iss, k, workspace->predictions, workspace->hidden,
+                          workspace->output, workspace->rng);
+  int n = workspace->predictions.size();
+  for (int i = 0; i < n; i++) {
+    labels[i] = workspace->predictions[i].second;
+    probs[i] = std::exp(workspace->predictions[i].first);
+  }
+  return n;
+}
+
+void pt_get_vector(const pt_model* model, pt_workspace* workspace,
+                   const char* word, float* vector) {
+  Vector& vec = workspace->hidden;
+  model->fasttext.getVector(vec, std::string(word));
+  for (int64_t j = 0; j < vec.m_; j++) {
+    vector[j] = vec[j];
+  }
+}
@@ -0,0 +1,55 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#ifndef POLARIZEDTEXT_H
+#define POLARIZEDTEXT_H
+
+/*
+ * C interface of libpolarizedtext. A model is loaded once and is then
+ * only read, so any number of threads may use it at the same time as
+ * long as each passes its own workspace. Workspaces hold the scratch
+ * buffers of one caller and must not be shared between threads.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct pt_model pt_model;
+typedef struct pt_workspace pt_workspace;
+
+/* NULL if the file cannot be opened; a corrupt file ends the process */
+pt_model* pt_load(const char* filename);
+void pt_free(pt_model* model);
+
+int pt_dimension(const pt_model* model);
+int pt_nlabels(const pt_model* model);
+/* valid as long as the model is loaded */
+const char* pt_label(const pt_model* model, int id);
+
+pt_workspace* pt_workspace_new(const pt_model* model);
+void pt_workspace_free(pt_workspace* workspace);
+
+/*
+ * Top k labels of a line of text, best first, as label ids and
+ * probabilities. Returns how many were written, 0 when the text has no
+ * known word.
+ */
+int pt_predict(const pt_model* model, pt_workspace* workspace,
+               const char* text, int k, int* labels, float* probs);
+
+/* pt_dimension floats */
+void pt_get_vector(const pt_model* model, pt_workspace* workspace,
+                   const char* word, float* vector);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,275 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include "productquantizer.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+
+namespace fasttext {
+
+const int32_t ProductQuantizer::MAX_POINTS;
+
+ProductQuantizer::ProductQuantizer() : ProductQuantizer(0, 1) {}
+
+// rows are cut into nsubq_ slices of dsub_ values (the last one may be
+// shorter), and each slice is replaced by the id of one of KSUB centroids
+ProductQuantizer::ProductQuantizer(int32_t dim, int32_t dsub)
+  : dim_(dim), nsubq_(dim / dsub), dsub_(dsub),
+    centroids_(dim * KSUB), rng(SEED)
+{
+  lastdsub_ = dim_ % dsub;
+  if (lastdsub_ == 0) {
+    lastdsub_ = dsub_;
+  } else {
+    nsubq_++;
+  }
+}
+
+int32_t ProductQuantizer::nsubq() const {
+  return nsubq_;
+}
+
+real* ProductQuantizer::getCentroids(int32_t m, uint8_t i) {
+  if (m == nsubq_ - 1) {
+    return &centroids_[m * KSUB * dsub_ + i * lastdsub_];
+  }
+  return &centroids_[(m * KSUB + i) * dsub_];
+}
+
+const real* ProductQuantizer::getCentroids(int32_t m, uint8_t i) const {
+  if (m == nsubq_ - 1) {
+    return &centroids_[m * KSUB * dsub_ + i * lastdsub_];
+  }
+  return &centroids_[(m * KSUB + i) * dsub_];
+}
+
+real ProductQuantizer::distL2(const real* x, const real* y, int32_t d) const {
+  real dist = 0;
+  for (int32_t i = 0; i < d; i++) {
+    real tmp = x[i] - y[i];
+    dist += tmp * tmp;
+  }
+  return dist;
+}
+
+real ProductQuantizer::assignCentroid(const real* x, const real* c0,
+                                      uint8_t* code, int32_t d) const {
+  const real* c = c0;
+  real dis = distL2(x, c, d);
+  code[0] = 0;
+  for (int32_t j = 1; j < KSUB; j++) {
+    c += d;
+    real disij = distL2(x, c, d);
+    if (disij < dis) {
+      code[0] = (uint8_t) j;
+      dis = disij;
+    }
+  }
+  return dis;
+}
+
+void ProductQuantizer::Estep(const real* x, const real* centroids,
+                             uint8_t* codes, int32_t d, int32_t n) const {
+  for (int32_t i = 0; i < n; i++) {
+    assignCentroid(x + i * d, centroids, codes + i, d);
+  }
+}
+
+void ProductQuantizer::MStep(const real* x0, real* centroids,
+                             const uint8_t* codes, int32_t d, int32_t n) {
+  std::vector<int32_t> nelts(KSUB, 0);
+  memset(centroids, 0, sizeof(real) * d * KSUB);
+  const real* x = x0;
+  for (int32_t i = 0; i < n; i++) {
+    uint8_t k = codes[i];
+    real* c = centroids + k * d;
+    for (int32_t j = 0; j < d; j++) {
+      c[j] += x[j];
+    }
+    nelts[k]++;
+    x += d;
+  }
+
+  real* c = centroids;
+  for (int32_t k = 0; k < KSUB; k++) {
+    real z = (real) nelts[k];
+    if (z != 0) {
+      for (int32_t j = 0; j < d; j++) {
+        c[j] /= z;
+      }
+    }
+    c += d;
+  }
+
+  // split a large cluster in two for every empty one
+  std::uniform_real_distribution<> runiform(0, 1);
+  for (int32_t k = 0; k < KSUB; k++) {
+    if (nelts[k] == 0) {
+      int32_t m = 0;
+      while (runiform(rng) * (n - KSUB) >= nelts[m] - 1) {
+        m = (m + 1) % KSUB;
+      }
+      memcpy(centroids + k * d, centroids + m * d, sizeof(real) * d);
+      for (int32_t j = 0; j < d; j++) {
+        int32_t sign = (j % 2) * 2 - 1;
+        centroids[k * d + j] += sign * 1e-7;
+        centroids[m * d + j] -= sign * 1e-7;
+      }
+      nelts[k] = nelts[m] / 2;
+      nelts[m] -= nelts[k];
+    }
+  }
+}
+
+void ProductQuantizer::kmeans(const real* x, real* c, int32_t n, int32_t d) {
+  std::vector<int32_t> perm(n, 0);
+  std::iota(perm.begin(), perm.end(), 0);
+  std::shuffle(perm.begin(), perm.end(), rng);
+  for (int32_t i = 0; i < KSUB; i++) {
+    memcpy(&c[i * d], x + perm[i] * d, d * sizeof(real));
+  }
+  std::vector<uint8_t> codes(n);
+  for (int32_t i = 0; i < NITER; i++) {
+    Estep(x, c, codes.data(), d, n);
+    MStep(x, c, codes.data(), d, n);
+  }
+}
+
+// x holds n contiguous rows of dim_ values
+void ProductQuantizer::train(int32_t n, const real* x) {
+  if (n < KSUB) {
+    std::cerr << "Matrix too small for quantization, must have at least "
+              << KSUB << " rows" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  std::vector<int32_t> perm(n, 0);
+  std::iota(perm.begin(), perm.end(), 0);
+  int32_t d = dsub_;
+  int32_t np = std::min(n, MAX_POINTS);
+  std::vector<real> xslice(np * dsub_);
+  for (int32_t m = 0; m < nsubq_; m++) {
+    if (m == nsubq_ - 1) {
+      d = lastdsub_;
+    }
+    if (np != n) {
+      std::shuffle(perm.begin(), perm.end(), rng);
+    }
+    for (int32_t j = 0; j < np; j++) {
+      memcpy(xslice.data() + j * d, x + int64_t(perm[j]) * dim_ + m * dsub_,
+             d * sizeof(real));
+    }
+    kmeans(xslice.data(), getCentroids(m, 0), np, d);
+  }
+}
+
+void ProductQuantizer::computeCode(const real* x, uint8_t* code) const {
+  int32_t d = dsub_;
+  for (int32_t m = 0; m < nsubq_; m++) {
+    if (m == nsubq_ - 1) {
+      d = lastdsub_;
+    }
+    assignCentroid(x + m * dsub_, getCentroids(m, 0), code + m, d);
+  }
+}
+
+void ProductQuantizer::computeCodes(const real* x, uint8_t* codes,
+                                    int32_t n) const {
+  for (int32_t i = 0; i < n; i++) {
+    computeCode(x + int64_t(i) * dim_, codes + int64_t(i) * nsubq_);
+  }
+}
+
+// dot products of every slice of x with every centroid of that slice;
+// scoring a code against x then costs nsubq_ lookups
+void ProductQuantizer::computeTable(const Vector& x,
+                                    std::vector<real>& table) const {
+  table.assign(nsubq_ * KSUB, 0.0);
+  int32_t d = dsub_;
+  for (int32_t m = 0; m < nsubq_; m++) {
+    if (m == nsubq_ - 1) {
+      d = lastdsub_;
+    }
+    const real* c = getCentroids(m, 0);
+    for (int32_t k = 0; k < KSUB; k++) {
+      real dot = 0.0;
+      for (int32_t j = 0; j < d; j++) {
+        dot += x[m * dsub_ + j] * c[j];
+      }
+      table[m * KSUB + k] = dot;
+      c += d;
+    }
+  }
+}
+
+real ProductQuantizer::mulcode(const Vector& x, const uint8_t* codes,
+                               int32_t t, real alpha) const {
+  real res = 0.0;
+  int32_t d = dsub_;
+  const uint8_t* code = codes + int64_t(nsubq_) * t;
+  for (int32_t m = 0; m < nsubq_; m++) {
+    const real* c = getCentroids(m, code[m]);
+    if (m == nsubq_ - 1) {
+      d = lastdsub_;
+    }
+    for (int32_t n = 0; n < d; n++) {
+      res += x[m * dsub_ + n] * c[n];
+    }
+  }
+  return res * alpha;
+}
+
+real ProductQuantizer::mulcode(const std::vector<real>& table,
+                               const uint8_t* codes, int32_t t,
+                               real alpha) const {
+  real res = 0.0;
+  const uint8_t* code = codes + int64_t(nsubq_) * t;
+  for (int32_t m = 0; m < nsubq_; m++) {
+    res += table[m * KSUB + code[m]];
+  }
+  return res * alpha;
+}
+
+void ProductQuantizer::addcode(Vector& x, const uint8_t* codes,
+                               int32_t t, real alpha) const {
+  int32_t d = dsub_;
+  const uint8_t* code = codes + int64_t(nsubq_) * t;
+  for (int32_t m = 0; m < nsubq_; m++) {
+    const real* c = getCentroids(m, code[m]);
+    if (m == nsubq_ - 1) {
+      d = lastdsub_;
+    }
+    for (int32_t n = 0; n < d; n++) {
+      x[m * dsub_ + n] += alpha * c[n];
+    }
+  }
+}
+
+void ProductQuantizer::save(std::ostream& out) {
+  out.write((char*) &dim_, sizeof(dim_));
+  out.write((char*) &nsubq_, sizeof(nsubq_));
+  out.write((char*) &dsub_, sizeof(dsub_));
+  out.write((char*) &lastdsub_, sizeof(lastdsub_));
+  out.write((char*) centroids_.data(), centroids_.size() * sizeof(real));
+}
+
+void ProductQuantizer::load(std::istream& in) {
+  in.read((char*) &dim_, sizeof(dim_));
+  in.read((char*) &nsubq_, sizeof(nsubq_));
+  in.read((char*) &dsub_, sizeof(dsub_));
+  in.read((char*) &lastdsub_, sizeof(lastdsub_));
+  centroids_.resize(dim_ * KSUB);
+  in.read((char*) centroids_.data(), centroids_.size() * sizeof(real));
+}
+
+}
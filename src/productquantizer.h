@@ -0,0 +1,68 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#ifndef FASTTEXT_PRODUCT_QUANTIZER_H
+#define FASTTEXT_PRODUCT_QUANTIZER_H
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <random>
+#include <vector>
+
+#include "real.h"
+#include "vector.h"
+
+namespace fasttext {
+
+class ProductQuantizer {
+  private:
+    static const int32_t NBITS = 8;
+    static const int32_t KSUB = 1 << NBITS;
+    static const int32_t MAX_POINTS_PER_CLUSTER = 256;
+    static const int32_t MAX_POINTS = MAX_POINTS_PER_CLUSTER * KSUB;
+    static const int32_t SEED = 1234;
+    static const int32_t NITER = 25;
+
+    int32_t dim_;
+    int32_t nsubq_;
+    int32_t dsub_;
+    int32_t lastdsub_;
+    std::vector<real> centroids_;
+    std::minstd_rand rng;
+
+    real distL2(const real*, const real*, int32_t) const;
+    real assignCentroid(const real*, const real*, uint8_t*, int32_t) const;
+    void Estep(const real*, const real*, uint8_t*, int32_t, int32_t) const;
+    void MStep(const real*, real*, const uint8_t*, int32_t, int32_t);
+    void kmeans(const real*, real*, int32_t, int32_t);
+
+  public:
+    ProductQuantizer();
+    ProductQuantizer(int32_t, int32_t);
+
+    int32_t nsubq() const;
+    real* getCentroids(int32_t, uint8_t);
+    const real* getCentroids(int32_t, uint8_t) const;
+
+    void train(int32_t, const real*);
+    void computeCode(const real*, uint8_t*) const;
+    void computeCodes(const real*, uint8_t*, int32_t) const;
+    void computeTable(const Vector&, std::vector<real>&) const;
+    real mulcode(const Vector&, const uint8_t*, int32_t, real) const;
+    real mulcode(const std::vector<real>&, const uint8_t*, int32_t, real) const;
+    void addcode(Vector&, const uint8_t*, int32_t, real) const;
+
+    void save(std::ostream&);
+    void load(std::istream&);
+};
+
+}
+
+#endif
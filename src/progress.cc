@@ -0,0 +1,57 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include "progress.h"
+
+#include "allocator.h"
+
+#include <new>
+
+namespace fasttext {
+
+ProgressCounter::ProgressCounter(int32_t nthreads) : nthreads_(nthreads) {
+  counts_ = (std::atomic<int64_t>*) allocator::allocate(bytes());
+  for (int32_t i = 0; i < nthreads_; i++) {
+    new (&counts_[i * STRIDE]) std::atomic<int64_t>(0);
+  }
+}
+
+ProgressCounter::~ProgressCounter() {
+  for (int32_t i = 0; i < nthreads_; i++) {
+    counts_[i * STRIDE].~atomic();
+  }
+  allocator::deallocate(counts_, bytes());
+}
+
+int64_t ProgressCounter::bytes() const {
+  return nthreads_ * STRIDE * sizeof(std::atomic<int64_t>);
+}
+
+// only the owning thread writes its slot, so a plain load and store is
+// enough and the line never leaves that core for a read-modify-write
+void ProgressCounter::add(int32_t threadId, int64_t n) {
+  std::atomic<int64_t>& c = counts_[threadId * STRIDE];
+  c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+int64_t ProgressCounter::total() const {
+  int64_t n = 0;
+  for (int32_t i = 0; i < nthreads_; i++) {
+    n += counts_[i * STRIDE].load(std::memory_order_relaxed);
+  }
+  return n;
+}
+
+void ProgressCounter::reset() {
+  for (int32_t i = 0; i < nthreads_; i++) {
+    counts_[i * STRIDE].store(0, std::memory_order_relaxed);
+  }
+}
+
+}
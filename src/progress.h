@@ -0,0 +1,41 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#ifndef FASTTEXT_PROGRESS_H
+#define FASTTEXT_PROGRESS_H
+
+#include <atomic>
+#include <cstdint>
+
+namespace fasttext {
+
+class ProgressCounter {
+  private:
+    // slots are two cache lines apart, so no two threads ever share one
+    static const int32_t STRIDE = 128 / sizeof(std::atomic<int64_t>);
+
+    std::atomic<int64_t>* counts_; // cache-line aligned
+    int32_t nthreads_;
+
+    int64_t bytes() const;
+
+  public:
+    explicit ProgressCounter(int32_t);
+    ProgressCounter(const ProgressCounter&) = delete;
+    ProgressCounter& operator=(const ProgressCounter&) = delete;
+    ~ProgressCounter();
+
+    void add(int32_t, int64_t);
+    int64_t total() const;
+    void reset();
+};
+
+}
+
+#endif
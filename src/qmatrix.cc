@@ -0,0 +1,121 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include "qmatrix.h"
+
+#include <assert.h>
+
+#include <cmath>
+
+namespace fasttext {
+
+QMatrix::QMatrix() : qnorm_(false), m_(0), n_(0) {}
+
+QMatrix::QMatrix(const Matrix& mat, int32_t dsub, bool qnorm)
+  : pq_(new ProductQuantizer(mat.n_, dsub)), qnorm_(qnorm),
+    m_(mat.m_), n_(mat.n_)
+{
+  codes_.resize(m_ * pq_->nsubq());
+  if (qnorm_) {
+    npq_.reset(new ProductQuantizer(1, 1));
+    normCodes_.resize(m_);
+  }
+  quantize(mat);
+}
+
+// with qnorm, rows are quantized on the unit sphere and their norms get
+// a one-dimensional quantizer of their own
+void QMatrix::quantize(const Matrix& mat) {
+  std::vector<real> rows(m_ * n_);
+  for (int64_t i = 0; i < m_; i++) {
+    mat.getRow(i, rows.data() + i * n_);
+  }
+  if (qnorm_) {
+    std::vector<real> norms(m_);
+    for (int64_t i = 0; i < m_; i++) {
+      real* row = rows.data() + i * n_;
+      real norm = 0.0;
+      for (int64_t j = 0; j < n_; j++) {
+        norm += row[j] * row[j];
+      }
+      norms[i] = std::sqrt(norm);
+      for (int64_t j = 0; j < n_ && norms[i] > 0; j++) {
+        row[j] /= norms[i];
+      }
+    }
+    npq_->train(m_, norms.data());
+    npq_->computeCodes(norms.data(), normCodes_.data(), m_);
+  }
+  pq_->train(m_, rows.data());
+  pq_->computeCodes(rows.data(), codes_.data(), m_);
+}
+
+real QMatrix::getNorm(int64_t i) const {
+  return qnorm_ ? npq_->getCentroids(0, normCodes_[i])[0] : 1.0;
+}
+
+real QMatrix::dotRow(const Vector& vec, int64_t i) const {
+  assert(i >= 0);
+  assert(i < m_);
+  return pq_->mulcode(vec, codes_.data(), i, getNorm(i));
+}
+
+void QMatrix::addToVector(Vector& x, int64_t i) const {
+  assert(i >= 0);
+  assert(i < m_);
+  pq_->addcode(x, codes_.data(), i, getNorm(i));
+}
+
+// scores of every row against vec, through one table of slice products
+void QMatrix::mulAll(const Vector& vec, Vector& out) const {
+  assert(out.m_ == m_);
+  std::vector<real> table;
+  pq_->computeTable(vec, table);
+  for (int64_t i = 0; i < m_; i++) {
+    out[i] = pq_->mulcode(table, codes_.data(), i, getNorm(i));
+  }
+}
+
+int64_t QMatrix::bytes() const {
+  return codes_.size() + normCodes_.size();
+}
+
+void QMatrix::save(std::ostream& out) {
+  out.write((char*) &qnorm_, sizeof(qnorm_));
+  out.write((char*) &m_, sizeof(m_));
+  out.write((char*) &n_, sizeof(n_));
+  int64_t codesize = codes_.size();
+  out.write((char*) &codesize, sizeof(codesize));
+  out.write((char*) codes_.data(), codesize * sizeof(uint8_t));
+  pq_->save(out);
+  if (qnorm_) {
+    out.write((char*) normCodes_.data(), m_ * sizeof(uint8_t));
+    npq_->save(out);
+  }
+}
+
+void QMatrix::load(std::istream& in) {
+  in.read((char*) &qnorm_, sizeof(qnorm_));
+  in.read((char*) &m_, sizeof(m_));
+  in.read((char*) &n_, sizeof(n_));
+  int64_t codesize;
+  in.read((char*) &codesize, sizeof(codesize));
+  codes_.resize(codesize);
+  in.read((char*) codes_.data(), codesize * sizeof(uint8_t));
+  pq_.reset(new ProductQuantizer());
+  pq_->load(in);
+  if (qnorm_) {
+    normCodes_.resize(m_);
+    in.read((char*) normCodes_.data(), m_ * sizeof(uint8_t));
+    npq_.reset(new ProductQuantizer());
+    npq_->load(in);
+  }
+}
+
+}
@@ -0,0 +1,55 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#ifndef FASTTEXT_QMATRIX_H
+#define FASTTEXT_QMATRIX_H
+
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+#include "matrix.h"
+#include "productquantizer.h"
+#include "real.h"
+#include "vector.h"
+
+namespace fasttext {
+
+class QMatrix {
+  private:
+    std::unique_ptr<ProductQuantizer> pq_;
+    std::unique_ptr<ProductQuantizer> npq_;
+    std::vector<uint8_t> codes_;
+    std::vector<uint8_t> normCodes_;
+    bool qnorm_;
+
+    real getNorm(int64_t) const;
+    void quantize(const Matrix&);
+
+  public:
+    int64_t m_;
+    int64_t n_;
+
+    QMatrix();
+    QMatrix(const Matrix&, int32_t, bool);
+
+    real dotRow(const Vector&, int64_t) const;
+    void addToVector(Vector&, int64_t) const;
+    void mulAll(const Vector&, Vector&) const;
+    int64_t bytes() const;
+
+    void save(std::ostream&);
+    void load(std::istream&);
+};
+
+}
+
+#endif
@@ -14,6 +14,9 @@ namespace fasttext {
 
 typedef float real;
 
+// how matrix rows are kept in memory and on disk; arithmetic is always real
+enum class storage_type : int {fp32=0, fp16, bf16};
+
 }
 
 #endif
@@ -0,0 +1,96 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include "rowops.h"
+
+namespace fasttext {
+
+namespace rowops {
+
+namespace {
+
+  // independent partial sums, so the dot product can run in vector lanes
+  const int32_t LANES = 8;
+
+  real dotGeneric(const real* x, const real* y, int64_t n) {
+    real d = 0.0;
+    for (int64_t j = 0; j < n; j++) {
+      d += x[j] * y[j];
+    }
+    return d;
+  }
+
+  void axpyGeneric(real* y, const real* x, real a, int64_t n) {
+    for (int64_t j = 0; j < n; j++) {
+      y[j] += a * x[j];
+    }
+  }
+
+  void addGeneric(real* y, const real* x, int64_t n) {
+    for (int64_t j = 0; j < n; j++) {
+      y[j] += x[j];
+    }
+  }
+
+  template <int64_t N>
+  real dot(const real* x, const real* y, int64_t) {
+    real s[LANES] = {};
+    for (int64_t j = 0; j + LANES <= N; j += LANES) {
+      for (int32_t l = 0; l < LANES; l++) {
+        s[l] += x[j + l] * y[j + l];
+      }
+    }
+    real d = 0.0;
+    for (int64_t j = N / LANES * LANES; j < N; j++) {
+      d += x[j] * y[j];
+    }
+    for (int32_t l = 0; l < LANES; l++) {
+      d += s[l];
+    }
+    return d;
+  }
+
+  // rows never overlap, which spares the fixed loops an aliasing check
+  template <int64_t N>
+  void axpy(real* __restrict__ y, const real* __restrict__ x, real a, int64_t) {
+    for (int64_t j = 0; j < N; j++) {
+      y[j] += a * x[j];
+    }
+  }
+
+  template <int64_t N>
+  void add(real* __restrict__ y, const real* __restrict__ x, int64_t) {
+    for (int64_t j = 0; j < N; j++) {
+      y[j] += x[j];
+    }
+  }
+
+  // constant-initialized, so usable before any static constructor runs
+  const Row table[] = {
+    {dot<16>, axpy<16>, add<16>, 16},
+    {dot<20>, axpy<20>, add<20>, 20},
+    {dot<32>, axpy<32>, add<32>, 32},
+    {dot<64>, axpy<64>, add<64>, 64},
+    {dot<100>, axpy<100>, add<100>, 100},
+    {dot<128>, axpy<128>, add<128>, 128},
+    {dot<300>, axpy<300>, add<300>, 300},
+  };
+  const Row generic = {dotGeneric, axpyGeneric, addGeneric, 0};
+}
+
+const Row& forDim(int64_t n) {
+  for (const Row& row : table) {
+    if (row.dim == n) return row;
+  }
+  return generic;
+}
+
+}
+
+}
@@ -0,0 +1,42 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#ifndef FASTTEXT_ROWOPS_H
+#define FASTTEXT_ROWOPS_H
+
+#include <cstdint>
+
+#include "real.h"
+
+namespace fasttext {
+
+namespace rowops {
+
+  // sum of x[j] * y[j]
+  typedef real (*dot_fn)(const real*, const real*, int64_t);
+  // y[j] += a * x[j]
+  typedef void (*axpy_fn)(real*, const real*, real, int64_t);
+  // y[j] += x[j]
+  typedef void (*add_fn)(real*, const real*, int64_t);
+
+  // Loops over fp32 rows of n elements. Common dims have their own copies
+  // with n fixed at compile time, fully unrolled; n is then ignored.
+  struct Row {
+    dot_fn dot;
+    axpy_fn axpy;
+    add_fn add;
+    int64_t dim; // 0 for the generic loops
+  };
+
+  const Row& forDim(int64_t);
+}
+
+}
+
+#endif
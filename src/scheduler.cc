@@ -0,0 +1,184 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include "scheduler.h"
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <iostream>
+
+#include "utils.h"
+
+namespace fasttext {
+
+// Every thread owns a deque holding its contiguous share of the chunks,
+// once per epoch. Threads pop from the front of their own deque and steal
+// from the back of the others when it runs dry, so each chunk is trained
+// exactly once per epoch and nobody idles while work remains.
+//
+// With several worker processes, every process cuts the file the same way
+// and takes every workers-th chunk from its rank on, the others being
+// marked done from the start. A file cut into fewer chunks than there are
+// workers would leave some of them without any.
+ChunkScheduler::ChunkScheduler(std::ifstream& ifs, int32_t nthreads,
+                               int32_t epoch, int32_t rank, int32_t workers)
+  : epoch_(epoch) {
+  utils::seek(ifs, 0);
+  size_ = utils::size(ifs);
+  int64_t n = workers > 1 ? int64_t(workers) * CHUNKS_PER_SHARD
+                          : int64_t(nthreads) * CHUNKS_PER_THREAD;
+  n = std::min(n, std::max(int64_t(workers), size_ / MIN_CHUNK_SIZE));
+  n = std::max(n, size_ / MAX_CHUNK_SIZE);
+  split(ifs, size_, n);
+
+  int64_t nchunks = chunks_.size();
+  if (nchunks < workers) {
+    std::cerr << "Input file has too few lines for -workers!" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  shard_ = 0;
+  for (int64_t c = rank; c < nchunks; c += workers) {
+    shard_ += chunks_[c].end - chunks_[c].begin;
+  }
+  n = nchunks * epoch_;
+  done_.reset(new std::atomic<bool>[n]);
+  for (int64_t i = 0; i < n; i++) {
+    done_[i] = (i % nchunks) % workers != rank;
+  }
+  assign(nthreads);
+}
+
+ChunkScheduler::ChunkScheduler() : size_(0), shard_(0), epoch_(0) {}
+
+// the chunks and progress written by save, for a file of the given size;
+// only the tasks not done yet are scheduled again
+void ChunkScheduler::load(std::istream& in, int64_t size, int32_t nthreads) {
+  int64_t n;
+  in.read((char*) &size_, sizeof(int64_t));
+  in.read((char*) &epoch_, sizeof(int32_t));
+  in.read((char*) &n, sizeof(int64_t));
+  if (!in || size_ != size || n <= 0) {
+    std::cerr << "Checkpoint does not match the input file!" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  chunks_.resize(n);
+  in.read((char*) chunks_.data(), n * sizeof(Chunk));
+  shard_ = size_;
+  n *= epoch_;
+  done_.reset(new std::atomic<bool>[n]);
+  for (int64_t i = 0; i < n; i++) {
+    bool done;
+    in.read((char*) &done, sizeof(bool));
+    done_[i] = done;
+  }
+  assign(nthreads);
+}
+
+// each thread gets a contiguous share of the chunks, once per epoch
+void ChunkScheduler::assign(int32_t nthreads) {
+  int64_t n = chunks_.size();
+  for (int32_t t = 0; t < nthreads; t++) {
+    queues_.push_back(std::unique_ptr<Queue>(new Queue()));
+    for (int32_t e = 0; e < epoch_; e++) {
+      for (int64_t c = t * n / nthreads; c < (t + 1) * n / nthreads; c++) {
+        if (!done_[e * n + c]) {
+          queues_[t]->tasks.push_back(e * n + c);
+        }
+      }
+    }
+  }
+  current_.assign(nthreads, -1);
+}
+
+// fraction of the file this process trains on
+double ChunkScheduler::share() const {
+  return size_ > 0 ? double(shard_) / size_ : 1.0;
+}
+
+// cut the file into roughly equal chunks, each starting at a line boundary
+void ChunkScheduler::split(std::ifstream& ifs, int64_t size, int64_t n) {
+  int64_t begin = 0;
+  for (int64_t k = 1; k < n && begin < size; k++) {
+    int64_t end = k * size / n;
+    if (end <= begin) continue;
+    utils::seek(ifs, end - 1);
+    int c;
+    while ((c = ifs.get()) != EOF && c != '\n') {}
+    end = (c == EOF) ? size : int64_t(ifs.tellg());
+    if (end <= begin || end >= size) continue;
+    chunks_.push_back(Chunk{begin, end});
+    begin = end;
+  }
+  if (begin < size || chunks_.empty()) {
+    chunks_.push_back(Chunk{begin, size});
+  }
+  utils::seek(ifs, 0);
+}
+
+bool ChunkScheduler::pop(int32_t threadId, int64_t& task) {
+  Queue& q = *queues_[threadId];
+  std::lock_guard<std::mutex> lock(q.mtx);
+  if (q.tasks.empty()) return false;
+  task = q.tasks.front();
+  q.tasks.pop_front();
+  return true;
+}
+
+bool ChunkScheduler::steal(int32_t threadId, int64_t& task) {
+  int32_t nthreads = queues_.size();
+  for (int32_t i = 1; i < nthreads; i++) {
+    Queue& q = *queues_[(threadId + i) % nthreads];
+    std::lock_guard<std::mutex> lock(q.mtx);
+    if (q.tasks.empty()) continue;
+    task = q.tasks.back();
+    q.tasks.pop_back();
+    return true;
+  }
+  return false;
+}
+
+// asking for the next chunk marks the previous one of the thread as done
+bool ChunkScheduler::next(int32_t threadId, Chunk& chunk) {
+  if (current_[threadId] >= 0) {
+    done_[current_[threadId]] = true;
+    current_[threadId] = -1;
+  }
+  int64_t task;
+  if (!pop(threadId, task) && !steal(threadId, task)) {
+    return false;
+  }
+  current_[threadId] = task;
+  chunk = chunks_[task % chunks_.size()];
+  return true;
+}
+
+// drops the tasks left; threads end after the chunk they are on
+void ChunkScheduler::stop() {
+  for (auto& q : queues_) {
+    std::lock_guard<std::mutex> lock(q->mtx);
+    q->tasks.clear();
+  }
+}
+
+// may run while the threads train: a task is done once its thread moved
+// past it, so chunks being trained are scheduled again on resume
+void ChunkScheduler::save(std::ostream& out) const {
+  int64_t n = chunks_.size();
+  out.write((char*) &size_, sizeof(int64_t));
+  out.write((char*) &epoch_, sizeof(int32_t));
+  out.write((char*) &n, sizeof(int64_t));
+  out.write((char*) chunks_.data(), n * sizeof(Chunk));
+  for (int64_t i = 0; i < n * epoch_; i++) {
+    bool done = done_[i];
+    out.write((char*) &done, sizeof(bool));
+  }
+}
+
+}
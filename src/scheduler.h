@@ -0,0 +1,68 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#ifndef FASTTEXT_SCHEDULER_H
+#define FASTTEXT_SCHEDULER_H
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace fasttext {
+
+struct Chunk {
+  int64_t begin;
+  int64_t end;
+};
+
+class ChunkScheduler {
+  private:
+    static const int64_t MIN_CHUNK_SIZE = 1 << 16;
+    static const int64_t MAX_CHUNK_SIZE = 1 << 26;
+    static const int32_t CHUNKS_PER_THREAD = 16;
+    static const int32_t CHUNKS_PER_SHARD = 64;
+
+    struct Queue {
+      std::mutex mtx;
+      std::deque<int64_t> tasks;
+    };
+
+    std::vector<Chunk> chunks_;
+    std::vector<std::unique_ptr<Queue>> queues_;
+    int64_t size_;
+    int64_t shard_; // bytes trained by this process each epoch
+    int32_t epoch_;
+    std::unique_ptr<std::atomic<bool>[]> done_;
+    std::vector<int64_t> current_; // task of each thread, -1 if none
+
+    void split(std::ifstream&, int64_t, int64_t);
+    void assign(int32_t);
+    bool pop(int32_t, int64_t&);
+    bool steal(int32_t, int64_t&);
+
+  public:
+    ChunkScheduler();
+    ChunkScheduler(std::ifstream&, int32_t, int32_t, int32_t = 0, int32_t = 1);
+
+    double share() const;
+    bool next(int32_t, Chunk&);
+    void stop();
+    void save(std::ostream&) const;
+    void load(std::istream&, int64_t, int32_t);
+};
+
+}
+
+#endif
@@ -0,0 +1,256 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include "server.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <thread>
+
+#include "vectors.h"
+
+namespace fasttext {
+
+const int32_t Server::LATENCY_WINDOW;
+
+Server::Server(const FastText& fasttext, int32_t k, int64_t budgetUs,
+               int32_t maxBatch, int32_t threads)
+  : fasttext_(fasttext), k_(std::max(1, k)),
+    budget_(std::chrono::microseconds(std::max<int64_t>(0, budgetUs))),
+    maxBatch_(std::max(1, maxBatch)), threads_(std::max(1, threads)),
+    closing_(false), requests_(0), batches_(0), maxQueue_(0),
+    latencies_(LATENCY_WINDOW), nlatencies_(0) {}
+
+static bool writeAll(int fd, const std::string& s) {
+  const char* p = s.data();
+  size_t left = s.size();
+  while (left > 0) {
+    ssize_t n = write(fd, p, left);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    p += n;
+    left -= n;
+  }
+  return true;
+}
+
+// stores the reply and writes out every reply of the connection that is
+// ready and no longer waits behind an earlier one
+void Server::finish(Connection& conn, Reply& reply, const std::string& text) {
+  std::lock_guard<std::mutex> lock(conn.mtx);
+  reply.text = text;
+  reply.done = true;
+  std::string out;
+  while (!conn.pending.empty() && conn.pending.front()->done) {
+    out += conn.pending.front()->text;
+    out += '\n';
+    conn.pending.pop_front();
+  }
+  if (!out.empty() && !conn.broken) {
+    conn.broken = !writeAll(conn.out, out);
+  }
+  if (conn.pending.empty()) {
+    conn.drained.notify_all();
+  }
+}
+
+// waits for a batch: full, or with its oldest request past the budget;
+// false once the server closes and the queue is empty
+bool Server::nextBatch(std::vector<Request>& batch) {
+  std::unique_lock<std::mutex> lock(mtx_);
+  while (true) {
+    if (queue_.empty()) {
+      if (closing_) return false;
+      cv_.wait(lock);
+      continue;
+    }
+    if (queue_.size() >= maxBatch_ || closing_) break;
+    clock::time_point deadline = queue_.front().arrival + budget_;
+    if (clock::now() >= deadline) break;
+    cv_.wait_until(lock, deadline);
+  }
+  size_t n = std::min(queue_.size(), maxBatch_);
+  batch.assign(std::make_move_iterator(queue_.begin()),
+               std::make_move_iterator(queue_.begin() + n));
+  queue_.erase(queue_.begin(), queue_.begin() + n);
+  batches_++;
+  if (!queue_.empty()) cv_.notify_one();
+  return true;
+}
+
+void Server::worker(int32_t threadId) {
+  Vector hidden(fasttext_.getArgs()->dim);
+  Vector output(fasttext_.getDictionary()->nlabels());
+  std::minstd_rand rng(threadId);
+  std::vector<Request> batch;
+  std::vector<std::pair<real, std::string>> predictions;
+  std::vector<std::string> replies;
+  std::vector<int64_t> latencies;
+  char buffer[32];
+  while (nextBatch(batch)) {
+    replies.resize(batch.size());
+    for (size_t i = 0; i < batch.size(); i++) {
+      std::istringstream iss(batch[i].text);
+      fasttext_.predict(iss, k_, predictions, hidden, output, rng);
+      std::string& r = replies[i];
+      r.clear();
+      for (auto it = predictions.cbegin(); it != predictions.cend(); it++) {
+        if (it != predictions.cbegin()) r += ' ';
+        r += it->second;
+        r += ' ';
+        r.append(buffer, vectors::formatReal(std::exp(it->first), buffer));
+      }
+      if (predictions.empty()) r = "n/a";
+    }
+    clock::time_point now = clock::now();
+    latencies.clear();
+    for (size_t i = 0; i < batch.size(); i++) {
+      finish(*batch[i].conn, *batch[i].reply, replies[i]);
+      latencies.push_back(std::chrono::duration_cast<std::chrono::microseconds>(
+          now - batch[i].arrival).count());
+    }
+    std::lock_guard<std::mutex> lock(mtx_);
+    for (int64_t l : latencies) {
+      latencies_[nlatencies_++ % LATENCY_WINDOW] = l;
+    }
+  }
+}
+
+std::string Server::stats() {
+  std::lock_guard<std::mutex> lock(mtx_);
+  std::vector<int64_t> window(latencies_.begin(),
+      latencies_.begin() + std::min<int64_t>(nlatencies_, LATENCY_WINDOW));
+  auto percentile = [&window](double p) -> int64_t {
+    if (window.empty()) return 0;
+    size_t i = std::min(window.size() - 1, size_t(p * window.size()));
+    std::nth_element(window.begin(), window.begin() + i, window.end());
+    return window[i];
+  };
+  std::ostringstream oss;
+  oss << "requests " << requests_ << " batches " << batches_
+      << " queue " << queue_.size() << " maxqueue " << maxQueue_
+      << " p50us " << percentile(0.5) << " p99us " << percentile(0.99);
+  return oss.str();
+}
+
+// reads the requests of one client until it hangs up, then waits for
+// their replies to be written
+void Server::handle(std::shared_ptr<Connection> conn) {
+  std::string line;
+  char chunk[1 << 16];
+  bool eof = false;
+  while (!eof) {
+    ssize_t n = read(conn->in, chunk, sizeof(chunk));
+    if (n < 0 && errno == EINTR) continue;
+    eof = n <= 0;
+    const char* p = chunk;
+    const char* end = chunk + (eof ? 0 : n);
+    while (p < end || (eof && !line.empty())) {
+      const char* nl = p < end ? (const char*) memchr(p, '\n', end - p) : nullptr;
+      if (nl == nullptr && !eof) {
+        line.append(p, end);
+        break;
+      }
+      if (nl != nullptr) {
+        line.append(p, nl);
+        p = nl + 1;
+      }
+      if (!line.empty() && line.back() == '\r') line.pop_back();
+      auto reply = std::make_shared<Reply>();
+      reply->done = false;
+      {
+        std::lock_guard<std::mutex> lock(conn->mtx);
+        conn->pending.push_back(reply);
+      }
+      if (line == "STATS") {
+        finish(*conn, *reply, stats());
+      } else {
+        std::lock_guard<std::mutex> lock(mtx_);
+        queue_.push_back(Request{line, conn, reply, clock::now()});
+        requests_++;
+        maxQueue_ = std::max<int64_t>(maxQueue_, queue_.size());
+        cv_.notify_one();
+      }
+      line.clear();
+    }
+  }
+  std::unique_lock<std::mutex> lock(conn->mtx);
+  conn->drained.wait(lock, [&conn] { return conn->pending.empty(); });
+  close(conn->in);
+  if (conn->out != conn->in) close(conn->out);
+}
+
+// "-" serves stdin until it ends; anything else is the path of a Unix
+// domain socket served until the process is killed
+void Server::run(const std::string& path) {
+  std::vector<std::thread> workers;
+  for (int32_t t = 0; t < threads_; t++) {
+    workers.push_back(std::thread(&Server::worker, this, t));
+  }
+  if (path == "-") {
+    auto conn = std::make_shared<Connection>();
+    conn->in = STDIN_FILENO;
+    conn->out = STDOUT_FILENO;
+    conn->broken = false;
+    handle(conn);
+  } else {
+    signal(SIGPIPE, SIG_IGN);
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+      std::cerr << "Socket path is too long!" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    strcpy(addr.sun_path, path.c_str());
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(path.c_str());
+    if (fd < 0 || bind(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0 ||
+        listen(fd, SOMAXCONN) != 0) {
+      std::cerr << "Socket cannot be opened: " << strerror(errno) << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    std::cerr << "Serving on " << path << std::endl;
+    while (true) {
+      int client = accept(fd, nullptr, nullptr);
+      if (client < 0) {
+        if (errno == EINTR || errno == ECONNABORTED) continue;
+        std::cerr << "Accept failed: " << strerror(errno) << std::endl;
+        break;
+      }
+      auto conn = std::make_shared<Connection>();
+      conn->in = client;
+      conn->out = client;
+      conn->broken = false;
+      std::thread(&Server::handle, this, conn).detach();
+    }
+    close(fd);
+  }
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    closing_ = true;
+  }
+  cv_.notify_all();
+  for (auto& w : workers) {
+    w.join();
+  }
+}
+
+}
@@ -0,0 +1,92 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#ifndef FASTTEXT_SERVER_H
+#define FASTTEXT_SERVER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "fasttext.h"
+
+namespace fasttext {
+
+// Keeps a model loaded and answers one line of text with one line of
+// "label probability" pairs, over a Unix domain socket or stdin/stdout.
+// Requests from all clients share one queue; a worker takes them as a
+// batch once the batch is full or its oldest request has waited the
+// latency budget. Replies keep the order of the requests of each client,
+// so clients may pipeline. The line STATS is answered with counters,
+// queue depth and latency percentiles.
+class Server {
+  private:
+    typedef std::chrono::steady_clock clock;
+
+    static const int32_t LATENCY_WINDOW = 4096;
+
+    struct Reply {
+      std::string text;
+      bool done;
+    };
+
+    struct Connection {
+      int in;
+      int out;
+      bool broken;
+      std::mutex mtx;
+      std::condition_variable drained;
+      std::deque<std::shared_ptr<Reply>> pending; // in request order
+    };
+
+    struct Request {
+      std::string text;
+      std::shared_ptr<Connection> conn;
+      std::shared_ptr<Reply> reply;
+      clock::time_point arrival;
+    };
+
+    const FastText& fasttext_;
+    int32_t k_;
+    clock::duration budget_;
+    size_t maxBatch_;
+    int32_t threads_;
+
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    std::deque<Request> queue_;
+    bool closing_;
+
+    // guarded by mtx_
+    int64_t requests_;
+    int64_t batches_;
+    int64_t maxQueue_;
+    std::vector<int64_t> latencies_; // microseconds, last LATENCY_WINDOW
+    int64_t nlatencies_;
+
+    void worker(int32_t);
+    bool nextBatch(std::vector<Request>&);
+    void handle(std::shared_ptr<Connection>);
+    void finish(Connection&, Reply&, const std::string&);
+    std::string stats();
+
+  public:
+    Server(const FastText&, int32_t, int64_t, int32_t, int32_t);
+
+    void run(const std::string&);
+};
+
+}
+
+#endif
@@ -0,0 +1,253 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include "sync.h"
+
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <unordered_map>
+
+namespace fasttext {
+
+static bool isPath(const std::string& address) {
+  return address.find('/') != std::string::npos ||
+         address.find(':') == std::string::npos;
+}
+
+// a listening or connected socket, -1 if it cannot be opened
+static int openSocket(const std::string& address, bool listening) {
+  if (isPath(address)) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (address.size() >= sizeof(addr.sun_path)) {
+      std::cerr << "Socket path is too long!" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    strcpy(addr.sun_path, address.c_str());
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listening) unlink(address.c_str());
+    if (fd >= 0 && (listening ?
+        bind(fd, (struct sockaddr*) &addr, sizeof(addr)) == 0 &&
+        listen(fd, SOMAXCONN) == 0 :
+        connect(fd, (struct sockaddr*) &addr, sizeof(addr)) == 0)) {
+      return fd;
+    }
+    if (fd >= 0) close(fd);
+    return -1;
+  }
+  size_t colon = address.rfind(':');
+  std::string host = address.substr(0, colon);
+  std::string port = address.substr(colon + 1);
+  struct addrinfo hints, *res;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = listening ? AI_PASSIVE : 0;
+  if (getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &res) != 0) {
+    return -1;
+  }
+  int fd = -1;
+  for (struct addrinfo* ai = res; ai != nullptr && fd < 0; ai = ai->ai_next) {
+    fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (fd < 0) continue;
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (listening) {
+      setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    }
+    if (listening ? bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 &&
+                    listen(fd, SOMAXCONN) == 0 :
+                    connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+      break;
+    }
+    close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(res);
+  return fd;
+}
+
+static void lost() {
+  std::cerr << "Lost the connection between training processes!" << std::endl;
+  exit(EXIT_FAILURE);
+}
+
+static void writeAll(int fd, const std::vector<char>& buffer) {
+  const char* p = buffer.data();
+  size_t left = buffer.size();
+  while (left > 0) {
+    ssize_t n = write(fd, p, left);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) lost();
+    p += n;
+    left -= n;
+  }
+}
+
+static void readAll(int fd, void* data, size_t size) {
+  char* p = (char*) data;
+  while (size > 0) {
+    ssize_t n = read(fd, p, size);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) lost();
+    p += n;
+    size -= n;
+  }
+}
+
+static void append(std::vector<char>& buffer, const void* data, size_t size) {
+  buffer.insert(buffer.end(), (const char*) data, (const char*) data + size);
+}
+
+Coordinator::Coordinator(const std::string& address, int32_t workers,
+                         const std::vector<std::shared_ptr<Matrix>>& model)
+  : address_(address), workers_(workers) {
+  for (auto& m : model) {
+    model_.push_back(std::make_shared<Matrix>(*m));
+  }
+  fd_ = openSocket(address, true);
+  if (fd_ < 0) {
+    std::cerr << "Coordinator cannot listen on " << address << ": "
+              << strerror(errno) << std::endl;
+    exit(EXIT_FAILURE);
+  }
+}
+
+// serves rounds until every worker has left
+void Coordinator::run() {
+  std::vector<int> active;
+  while (int32_t(active.size()) < workers_) {
+    int fd = accept(fd_, nullptr, nullptr);
+    if (fd < 0 && (errno == EINTR || errno == ECONNABORTED)) continue;
+    if (fd < 0) lost();
+    active.push_back(fd);
+  }
+  close(fd_);
+  if (isPath(address_)) unlink(address_.c_str());
+  std::vector<real> row, value;
+  std::vector<char> reply;
+  while (!active.empty()) {
+    std::vector<std::unordered_map<int64_t, std::vector<real>>> changes(model_.size());
+    std::vector<int> staying;
+    for (int fd : active) {
+      int32_t last;
+      readAll(fd, &last, sizeof(int32_t));
+      for (size_t m = 0; m < model_.size(); m++) {
+        Matrix& mat = *model_[m];
+        row.resize(mat.n_);
+        value.resize(mat.n_);
+        int64_t count;
+        readAll(fd, &count, sizeof(int64_t));
+        for (int64_t c = 0; c < count; c++) {
+          int64_t i;
+          readAll(fd, &i, sizeof(int64_t));
+          readAll(fd, row.data(), mat.n_ * sizeof(real));
+          if (i < 0 || i >= mat.m_) lost();
+          mat.getRow(i, value.data());
+          std::vector<real>& change = changes[m][i];
+          change.resize(mat.n_, 0.0);
+          for (int64_t j = 0; j < mat.n_; j++) {
+            change[j] += row[j] - value[j];
+          }
+        }
+      }
+      if (last) {
+        close(fd);
+      } else {
+        staying.push_back(fd);
+      }
+    }
+    real scale = 1.0 / active.size();
+    reply.clear();
+    for (size_t m = 0; m < model_.size(); m++) {
+      Matrix& mat = *model_[m];
+      int64_t count = changes[m].size();
+      append(reply, &count, sizeof(int64_t));
+      for (auto& change : changes[m]) {
+        mat.getRow(change.first, value.data());
+        for (int64_t j = 0; j < mat.n_; j++) {
+          value[j] += scale * change.second[j];
+        }
+        mat.setRow(change.first, value.data());
+        append(reply, &change.first, sizeof(int64_t));
+        append(reply, value.data(), mat.n_ * sizeof(real));
+      }
+    }
+    for (int fd : staying) {
+      writeAll(fd, reply);
+    }
+    active.swap(staying);
+  }
+}
+
+const std::vector<std::shared_ptr<Matrix>>& Coordinator::model() const {
+  return model_;
+}
+
+// the coordinator may still be starting, so connecting is retried
+SyncClient::SyncClient(const std::string& address) {
+  for (int32_t attempt = 0; attempt < 600; attempt++) {
+    fd_ = openSocket(address, false);
+    if (fd_ >= 0) return;
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+  std::cerr << "Cannot reach the coordinator at " << address << "!" << std::endl;
+  exit(EXIT_FAILURE);
+}
+
+SyncClient::~SyncClient() {
+  close(fd_);
+}
+
+// sends the rows changed since the last round and, unless it is the last
+// one, takes the averaged rows back
+void SyncClient::sync(const std::vector<std::shared_ptr<Matrix>>& model, bool last) {
+  std::vector<char> buffer;
+  int32_t flag = last;
+  append(buffer, &flag, sizeof(int32_t));
+  for (auto& m : model) {
+    m->takeDirty(rows_);
+    row_.resize(m->n_);
+    int64_t count = rows_.size();
+    append(buffer, &count, sizeof(int64_t));
+    for (int64_t i : rows_) {
+      m->getRow(i, row_.data());
+      append(buffer, &i, sizeof(int64_t));
+      append(buffer, row_.data(), m->n_ * sizeof(real));
+    }
+  }
+  writeAll(fd_, buffer);
+  if (last) return;
+  for (auto& m : model) {
+    row_.resize(m->n_);
+    int64_t count;
+    readAll(fd_, &count, sizeof(int64_t));
+    for (int64_t c = 0; c < count; c++) {
+      int64_t i;
+      readAll(fd_, &i, sizeof(int64_t));
+      readAll(fd_, row_.data(), m->n_ * sizeof(real));
+      if (i < 0 || i >= m->m_) lost();
+      m->setRow(i, row_.data());
+    }
+  }
+}
+
+}
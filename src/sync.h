@@ -0,0 +1,60 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#ifndef FASTTEXT_SYNC_H
+#define FASTTEXT_SYNC_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "matrix.h"
+
+namespace fasttext {
+
+// Data-parallel training over processes. Every worker trains on its own
+// shard and from time to time sends the rows it changed since the last
+// round to the coordinator. The coordinator adds the mean of the changes
+// of the workers in the round to its copy of the model and sends back the
+// new value of every row anyone changed. A worker that is done sends its
+// last changes and leaves; the others go on without it.
+//
+// Addresses are Unix socket paths, or host:port for TCP.
+class Coordinator {
+  private:
+    std::vector<std::shared_ptr<Matrix>> model_;
+    std::string address_;
+    int32_t workers_;
+    int fd_;
+
+  public:
+    Coordinator(const std::string&, int32_t,
+                const std::vector<std::shared_ptr<Matrix>>&);
+
+    void run();
+    const std::vector<std::shared_ptr<Matrix>>& model() const;
+};
+
+class SyncClient {
+  private:
+    int fd_;
+    std::vector<int64_t> rows_;
+    std::vector<real> row_;
+
+  public:
+    explicit SyncClient(const std::string&);
+    ~SyncClient();
+
+    void sync(const std::vector<std::shared_ptr<Matrix>>&, bool);
+};
+
+}
+
+#endif
@@ -9,8 +9,21 @@
 
 #include "utils.h"
 
+#include <stdlib.h>
+#include <algorithm>
 #include <cmath>
 #include <ios>
+#include <iostream>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 namespace fasttext {
 
@@ -25,6 +38,86 @@ namespace utils {
     ifs.clear();
     ifs.seekg(std::streampos(pos));
   }
+
+  // n is a multiple of 8, the padded length of rows and vectors; eight
+  // running sums keep the loop free of a serial dependency so that it
+  // vectorizes
+  real dotPadded(const real* a, const real* b, int64_t n) {
+    real acc[8] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+    for (int64_t j = 0; j < n; j += 8) {
+      for (int32_t l = 0; l < 8; l++) {
+        acc[l] += a[j + l] * b[j + l];
+      }
+    }
+    return ((acc[0] + acc[4]) + (acc[1] + acc[5])) +
+           ((acc[2] + acc[6]) + (acc[3] + acc[7]));
+  }
+
+  // runs fn(thread, begin, end) over [begin, end) split between threads
+  void parallel(int64_t begin, int64_t end, int32_t threads,
+                std::function<void(int32_t, int64_t, int64_t)> fn) {
+    int64_t n = end - begin;
+    threads = std::max<int64_t>(1, std::min<int64_t>(threads, n));
+    std::vector<std::thread> workers;
+    for (int32_t t = 1; t < threads; t++) {
+      workers.push_back(std::thread(fn, t, begin + t * n / threads,
+                                    begin + (t + 1) * n / threads));
+    }
+    fn(0, begin, begin + n / threads);
+    for (auto& w : workers) {
+      w.join();
+    }
+  }
+
+  MappedFile::MappedFile(const std::string& filename)
+    : map_(nullptr), size_(0), data_(nullptr) {
+#ifdef __linux__
+    int fd = open(filename.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd >= 0 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+      size_ = st.st_size;
+      void* map = size_ > 0 ?
+          mmap(nullptr, size_, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0) : MAP_FAILED;
+      if (map != MAP_FAILED) {
+        map_ = map;
+        data_ = (const char*) map;
+      }
+    }
+    if (fd >= 0) {
+      close(fd);
+    }
+    if (data_ != nullptr || (fd >= 0 && size_ == 0)) return;
+#endif
+    std::ifstream ifs(filename, std::ifstream::binary);
+    if (!ifs.is_open()) {
+      std::cerr << "Input file cannot be opened!" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    buffer_.assign(std::istreambuf_iterator<char>(ifs),
+                   std::istreambuf_iterator<char>());
+    size_ = buffer_.size();
+    data_ = buffer_.data();
+  }
+
+  MappedFile::~MappedFile() {
+#ifdef __linux__
+    if (map_ != nullptr) {
+      munmap(map_, size_);
+    }
+#endif
+  }
+
+  const char* MappedFile::begin() const {
+    return data_;
+  }
+
+  const char* MappedFile::end() const {
+    return data_ + size_;
+  }
+
+  int64_t MappedFile::size() const {
+    return size_;
+  }
 }
 
 }
@@ -11,6 +11,11 @@
 #define FASTTEXT_UTILS_H
 
 #include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "real.h"
 
 namespace fasttext {
 
@@ -18,6 +23,29 @@ namespace utils {
 
   int64_t size(std::ifstream&);
   void seek(std::ifstream&, int64_t);
+
+  real dotPadded(const real*, const real*, int64_t);
+  void parallel(int64_t, int64_t, int32_t,
+                std::function<void(int32_t, int64_t, int64_t)>);
+
+  // read-only view of a whole file, mapped when possible
+  class MappedFile {
+    private:
+      void* map_;
+      int64_t size_;
+      std::vector<char> buffer_; // file contents when it cannot be mapped
+      const char* data_;
+
+    public:
+      explicit MappedFile(const std::string&);
+      MappedFile(const MappedFile&) = delete;
+      MappedFile& operator=(const MappedFile&) = delete;
+      ~MappedFile();
+
+      const char* begin() const;
+      const char* end() const;
+      int64_t size() const;
+  };
 }
 
 }
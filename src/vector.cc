@@ -14,19 +14,31 @@
 #include <iomanip>
 #include <iostream>
 
+#include "allocator.h"
+#include "half.h"
 #include "matrix.h"
 #include "utils.h"
 
 namespace fasttext {
 
+// padded like matrix rows, so vector loops may run in whole registers
+static int64_t bytes(int64_t m) {
+  return allocator::padded(m, sizeof(real)) * sizeof(real);
+}
+
+// the padding is zeroed once and never written, so whole-register dot
+// products over it add nothing
 Vector::Vector(int64_t m) {
   m_ = m;
-  data_ = new real[m];
+  data_ = (real*) allocator::allocate(bytes(m));
+  for (int64_t i = m; i < allocator::padded(m, sizeof(real)); i++) {
+    data_[i] = 0.0;
+  }
 }
 
 // make a vector with only non-zero item at indices at lbs
 Vector::Vector(int64_t m, const std::vector<int32_t>& lbs) 
-  : m_(m), data_(new real[m])
+  : Vector(m)
 {
   zero();
   for( auto l : lbs) {
@@ -36,7 +48,7 @@ Vector::Vector(int64_t m, const std::vector<int32_t>& lbs)
 }
 
 Vector::~Vector() {
-  delete[] data_;
+  allocator::deallocate(data_, bytes(m_));
 }
 
 int64_t Vector::size() const {
@@ -65,8 +77,14 @@ void Vector::addRow(const Matrix& A, int64_t i) {
   assert(i >= 0);
   assert(i < A.m_);
   assert(m_ == A.n_);
+  int64_t k = A.offset(i);
+  if (A.storage_ == storage_type::fp32) {
+    A.kernels_->add(data_, A.data_ + k, A.n_);
+    return;
+  }
+  const uint16_t* row = A.hdata_ + k;
   for (int64_t j = 0; j < A.n_; j++) {
-    data_[j] += A.data_[i * A.n_ + j];
+    data_[j] += half::toReal(row[j], A.storage_);
   }
 }
 
@@ -74,8 +92,14 @@ void Vector::addRow(const Matrix& A, int64_t i, real a) {
   assert(i >= 0);
   assert(i < A.m_);
   assert(m_ == A.n_);
+  int64_t k = A.offset(i);
+  if (A.storage_ == storage_type::fp32) {
+    A.kernels_->axpy(data_, A.data_ + k, a, A.n_);
+    return;
+  }
+  const uint16_t* row = A.hdata_ + k;
   for (int64_t j = 0; j < A.n_; j++) {
-    data_[j] += a * A.data_[i * A.n_ + j];
+    data_[j] += a * half::toReal(row[j], A.storage_);
   }
 }
 
@@ -89,11 +113,19 @@ void Vector::print() const{
 void Vector::mul(const Matrix& A, const Vector& vec) {
   assert(A.m_ == m_);
   assert(A.n_ == vec.m_);
+  if (A.storage_ == storage_type::fp32) {
+    for (int64_t i = 0; i < m_; i++) {
+      data_[i] = A.kernels_->dot(A.data_ + A.offset(i), vec.data_, A.n_);
+    }
+    return;
+  }
   for (int64_t i = 0; i < m_; i++) {
-    data_[i] = 0.0;
+    const uint16_t* row = A.hdata_ + A.offset(i);
+    real d = 0.0;
     for (int64_t j = 0; j < A.n_; j++) {
-      data_[i] += A.data_[i * A.n_ + j] * vec.data_[j];
+      d += half::toReal(row[j], A.storage_) * vec.data_[j];
     }
+    data_[i] = d;
   }
 }
 
@@ -0,0 +1,422 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include "vectors.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+#include "utils.h"
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fasttext {
+
+namespace vectors {
+
+  // words handed to the threads at a time when saving
+  const int64_t BLOCK = 1 << 14;
+  const int64_t HEADER = 2 * sizeof(int32_t) + 3 * sizeof(int64_t);
+
+  const double* powers() {
+    static double p[2 * 64 + 1];
+    static bool init = [] {
+      for (int32_t i = -64; i <= 64; i++) {
+        p[i + 64] = std::pow(10.0, i);
+      }
+      return true;
+    }();
+    (void) init;
+    return p + 64;
+  }
+
+  // same text as "%.5g", without going through printf
+  char* formatReal(real x, char* out) {
+    double v = x;
+    if (std::isnan(v) || std::isinf(v)) {
+      return out + sprintf(out, "%.5g", v);
+    }
+    if (v < 0) {
+      *out++ = '-';
+      v = -v;
+    }
+    if (v == 0) {
+      *out++ = '0';
+      return out;
+    }
+    const double* p = powers();
+    int32_t e = std::floor(std::log10(v));
+    int64_t digits = int64_t(std::nearbyint(v * p[4 - e]));
+    if (digits >= 100000) {
+      e++;
+      digits = int64_t(std::nearbyint(v * p[4 - e]));
+    } else if (digits < 10000) {
+      e--;
+      digits = int64_t(std::nearbyint(v * p[4 - e]));
+    }
+    if (digits >= 100000) {
+      e++;
+      digits /= 10;
+    }
+    char d[5];
+    for (int32_t k = 4; k >= 0; k--) {
+      d[k] = '0' + digits % 10;
+      digits /= 10;
+    }
+    int32_t nd = 5;
+    while (nd > 1 && d[nd - 1] == '0') nd--;
+    if (e < -4 || e >= 5) {
+      *out++ = d[0];
+      if (nd > 1) {
+        *out++ = '.';
+        for (int32_t k = 1; k < nd; k++) *out++ = d[k];
+      }
+      *out++ = 'e';
+      *out++ = e < 0 ? '-' : '+';
+      int32_t a = std::abs(e);
+      if (a >= 100) *out++ = '0' + a / 100;
+      *out++ = '0' + (a / 10) % 10;
+      *out++ = '0' + a % 10;
+    } else if (e >= 0) {
+      for (int32_t k = 0; k <= e; k++) *out++ = d[k];
+      if (nd > e + 1) {
+        *out++ = '.';
+        for (int32_t k = e + 1; k < nd; k++) *out++ = d[k];
+      }
+    } else {
+      *out++ = '0';
+      *out++ = '.';
+      for (int32_t k = 0; k < -e - 1; k++) *out++ = '0';
+      for (int32_t k = 0; k < nd; k++) *out++ = d[k];
+    }
+    return out;
+  }
+
+  // [-]digits[.digits][e[+-]digits]; anything else (inf, nan, hex, very
+  // long mantissas) goes to strtod. p must point into a null-terminated
+  // buffer; returns the end of the number, or p if there was none.
+  const char* parseReal(const char* p, real& x) {
+    const char* s = p;
+    bool neg = false;
+    if (*p == '-' || *p == '+') neg = *p++ == '-';
+    uint64_t m = 0;
+    int32_t digits = 0, scale = 0;
+    while (*p >= '0' && *p <= '9') {
+      if (digits < 19) {
+        m = m * 10 + (*p - '0');
+        digits += m > 0;
+      } else {
+        scale++;
+      }
+      p++;
+    }
+    bool any = p > s + (s[0] == '-' || s[0] == '+');
+    if (*p == '.') {
+      p++;
+      while (*p >= '0' && *p <= '9') {
+        if (digits < 19) {
+          m = m * 10 + (*p - '0');
+          digits += m > 0;
+          scale--;
+        }
+        p++;
+        any = true;
+      }
+    }
+    if (!any) {
+      char* end;
+      x = strtod(s, &end);
+      return end;
+    }
+    if (*p == 'e' || *p == 'E') {
+      const char* q = p + 1;
+      bool eneg = false;
+      if (*q == '-' || *q == '+') eneg = *q++ == '-';
+      if (*q >= '0' && *q <= '9') {
+        int32_t e = 0;
+        while (*q >= '0' && *q <= '9') {
+          e = std::min(e * 10 + (*q - '0'), 10000);
+          q++;
+        }
+        scale += eneg ? -e : e;
+        p = q;
+      }
+    }
+    if (digits > 15 || scale < -22 || scale > 22) {
+      char* end;
+      x = strtod(s, &end);
+      return end;
+    }
+    // both m and 10^|scale| are exact doubles here
+    double v = double(m);
+    v = scale < 0 ? v / powers()[-scale] : v * powers()[scale];
+    x = neg ? -v : v;
+    return p;
+  }
+
+  std::ofstream create(const std::string& filename) {
+    std::ofstream ofs(filename, std::ofstream::binary);
+    if (!ofs.is_open()) {
+      std::cerr << "Error opening file for saving vectors." << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    return ofs;
+  }
+
+  // words are formatted a block at a time, each thread into its own buffer
+  void saveText(const std::string& filename, const std::vector<std::string>& words,
+                int64_t dim, row_fn fn, int32_t threads) {
+    std::ofstream ofs = create(filename);
+    ofs << words.size() << " " << dim << "\n";
+    std::vector<std::string> out(threads);
+    for (int64_t b = 0; b < int64_t(words.size()); b += BLOCK) {
+      int64_t e = std::min<int64_t>(b + BLOCK, words.size());
+      utils::parallel(b, e, threads, [&](int32_t t, int64_t begin, int64_t end) {
+        Vector vec(dim);
+        std::string& s = out[t];
+        s.clear();
+        char num[32];
+        for (int64_t i = begin; i < end; i++) {
+          fn(i, vec);
+          s += words[i];
+          s += ' ';
+          for (int64_t j = 0; j < dim; j++) {
+            char* p = formatReal(vec[j], num);
+            *p++ = ' ';
+            s.append(num, p - num);
+          }
+          s += '\n';
+        }
+      });
+      for (auto& s : out) {
+        ofs.write(s.data(), s.size());
+        s.clear();
+      }
+    }
+    ofs.close();
+  }
+
+  void saveBinary(const std::string& filename, const std::vector<std::string>& words,
+                  int64_t dim, row_fn fn, int32_t threads) {
+    std::ofstream ofs = create(filename);
+    int64_t n = words.size();
+    int64_t offset = HEADER;
+    for (auto& w : words) {
+      offset += w.size() + 1;
+    }
+    int64_t padding = (64 - offset % 64) % 64;
+    offset += padding;
+    ofs.write((char*) &BVEC_MAGIC, sizeof(int32_t));
+    ofs.write((char*) &BVEC_VERSION, sizeof(int32_t));
+    ofs.write((char*) &n, sizeof(int64_t));
+    ofs.write((char*) &dim, sizeof(int64_t));
+    ofs.write((char*) &offset, sizeof(int64_t));
+    for (auto& w : words) {
+      ofs.write(w.c_str(), w.size() + 1);
+    }
+    for (int64_t i = 0; i < padding; i++) {
+      ofs.put(0);
+    }
+    std::vector<float> block(BLOCK * dim);
+    for (int64_t b = 0; b < n; b += BLOCK) {
+      int64_t e = std::min(b + BLOCK, n);
+      utils::parallel(b, e, threads, [&](int32_t, int64_t begin, int64_t end) {
+        Vector vec(dim);
+        for (int64_t i = begin; i < end; i++) {
+          fn(i, vec);
+          std::copy(vec.data_, vec.data_ + dim, block.begin() + (i - b) * dim);
+        }
+      });
+      ofs.write((char*) block.data(), (e - b) * dim * sizeof(float));
+    }
+    ofs.close();
+  }
+
+  Table::Table() : data_(nullptr), map_(nullptr), mapSize_(0), dim(0) {}
+
+  Table::~Table() {
+#ifdef __linux__
+    if (map_ != nullptr) {
+      munmap(map_, mapSize_);
+    }
+#endif
+  }
+
+  int64_t Table::size() const {
+    return words.size();
+  }
+
+  const real* Table::row(int64_t i) const {
+    return data_ + i * dim;
+  }
+
+  // the format is told by the first four bytes, not the extension
+  void Table::load(const std::string& filename, int32_t threads) {
+    std::ifstream ifs(filename, std::ifstream::binary);
+    if (!ifs.is_open()) {
+      std::cerr << "Pretrained vectors file cannot be opened!" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    int32_t magic = 0;
+    ifs.read((char*) &magic, sizeof(int32_t));
+    ifs.close();
+    if (magic == BVEC_MAGIC) {
+      loadBinary(filename);
+    } else {
+      loadText(filename, threads);
+    }
+  }
+
+  void Table::loadBinary(const std::string& filename) {
+    std::ifstream ifs(filename, std::ifstream::binary);
+    int32_t magic, version;
+    int64_t n, offset;
+    ifs.read((char*) &magic, sizeof(int32_t));
+    ifs.read((char*) &version, sizeof(int32_t));
+    ifs.read((char*) &n, sizeof(int64_t));
+    ifs.read((char*) &dim, sizeof(int64_t));
+    ifs.read((char*) &offset, sizeof(int64_t));
+    if (!ifs || version > BVEC_VERSION) {
+      std::cerr << "Invalid binary vectors file!" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    words.resize(n);
+    for (int64_t i = 0; i < n; i++) {
+      std::getline(ifs, words[i], '\0');
+    }
+    int64_t bytes = n * dim * sizeof(float);
+#ifdef __linux__
+    int fd = open(filename.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd >= 0 && fstat(fd, &st) == 0 && st.st_size >= offset + bytes) {
+      mapSize_ = st.st_size;
+      void* map = mmap(nullptr, mapSize_, PROT_READ, MAP_PRIVATE, fd, 0);
+      close(fd);
+      if (map != MAP_FAILED) {
+        madvise(map, mapSize_, MADV_SEQUENTIAL);
+        map_ = map;
+        data_ = (const real*) ((const char*) map + offset);
+        return;
+      }
+    } else if (fd >= 0) {
+      close(fd);
+    }
+#endif
+    rows_.resize(n * dim);
+    ifs.seekg(offset);
+    ifs.read((char*) rows_.data(), bytes);
+    if (!ifs) {
+      std::cerr << "Invalid binary vectors file!" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    data_ = rows_.data();
+  }
+
+  // next line holding a record, or end
+  const char* skipBlank(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) p++;
+    return p;
+  }
+
+  const char* lineEnd(const char* p, const char* end) {
+    const char* q = (const char*) memchr(p, '\n', end - p);
+    return q == nullptr ? end : q;
+  }
+
+  // The file is read whole and cut into one range per thread at line
+  // boundaries. A first pass counts the records of every range so that
+  // each thread knows where its rows go, a second one parses them.
+  void Table::loadText(const std::string& filename, int32_t threads) {
+    std::ifstream ifs(filename, std::ifstream::binary);
+    std::string text((std::istreambuf_iterator<char>(ifs)),
+                     std::istreambuf_iterator<char>());
+    ifs.close();
+    const char* begin = text.c_str();
+    const char* end = begin + text.size();
+    int64_t n;
+    if (sscanf(begin, "%" SCNd64 " %" SCNd64, &n, &dim) != 2 || n < 0 || dim <= 0) {
+      std::cerr << "Invalid vectors file header!" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    begin = lineEnd(begin, end);
+
+    threads = std::max(1, threads);
+    std::vector<const char*> cuts(threads + 1, end);
+    cuts[0] = begin;
+    for (int32_t t = 1; t < threads; t++) {
+      const char* p = begin + (end - begin) * t / threads;
+      cuts[t] = std::max(cuts[t - 1], lineEnd(p, end));
+    }
+    std::vector<int64_t> first(threads + 1, 0);
+    utils::parallel(0, threads, threads, [&](int32_t, int64_t from, int64_t to) {
+      for (int64_t t = from; t < to; t++) {
+        int64_t count = 0;
+        for (const char* p = skipBlank(cuts[t], cuts[t + 1]); p < cuts[t + 1];
+             p = skipBlank(lineEnd(p, cuts[t + 1]), cuts[t + 1])) {
+          count++;
+        }
+        first[t + 1] = count;
+      }
+    });
+    for (int32_t t = 0; t < threads; t++) {
+      first[t + 1] += first[t];
+    }
+    if (first[threads] != n) {
+      std::cerr << "Vectors file has " << first[threads]
+                << " rows but its header says " << n << "!" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    words.resize(n);
+    rows_.resize(n * dim);
+    std::atomic<bool> bad(false);
+    utils::parallel(0, threads, threads, [&](int32_t, int64_t from, int64_t to) {
+      for (int64_t t = from; t < to; t++) {
+        int64_t i = first[t];
+        for (const char* p = skipBlank(cuts[t], cuts[t + 1]); p < cuts[t + 1]; i++) {
+          const char* e = lineEnd(p, cuts[t + 1]);
+          const char* w = p;
+          while (p < e && *p != ' ' && *p != '\t') p++;
+          words[i].assign(w, p);
+          real* row = rows_.data() + i * dim;
+          for (int64_t j = 0; j < dim; j++) {
+            while (p < e && (*p == ' ' || *p == '\t')) p++;
+            const char* q = p < e ? parseReal(p, row[j]) : p;
+            if (q == p || q > e) {
+              bad = true;
+              row[j] = 0.0;
+              continue;
+            }
+            p = q;
+          }
+          p = skipBlank(e, cuts[t + 1]);
+        }
+      }
+    });
+    if (bad) {
+      std::cerr << "Some vectors have fewer than " << dim << " values!" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    data_ = rows_.data();
+  }
+}
+
+}
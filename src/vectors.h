@@ -0,0 +1,71 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#ifndef FASTTEXT_VECTORS_H
+#define FASTTEXT_VECTORS_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "real.h"
+#include "vector.h"
+
+namespace fasttext {
+
+// Word vector files. Text (.vec): a "n dim" line, then one "word v1 .. vdim"
+// line per word. Binary (.bvec): a header, the null-terminated words, then
+// the n x dim float32 rows back to back, starting on a 64-byte boundary so
+// the block can be used straight from a mapping of the file.
+namespace vectors {
+
+  const int32_t BVEC_MAGIC = 0x63657662; // "bvec"
+  const int32_t BVEC_VERSION = 1;
+
+  // fills the vector of word i; called from several threads at once
+  typedef std::function<void(int64_t, Vector&)> row_fn;
+
+  void saveText(const std::string&, const std::vector<std::string>&,
+                int64_t, row_fn, int32_t);
+  void saveBinary(const std::string&, const std::vector<std::string>&,
+                  int64_t, row_fn, int32_t);
+
+  // words and their rows, either parsed from text or mapped from a .bvec
+  class Table {
+    private:
+      std::vector<real> rows_;
+      const real* data_;
+      void* map_;
+      int64_t mapSize_;
+
+      void loadText(const std::string&, int32_t);
+      void loadBinary(const std::string&);
+
+    public:
+      std::vector<std::string> words;
+      int64_t dim;
+
+      Table();
+      Table(const Table&) = delete;
+      Table& operator=(const Table&) = delete;
+      ~Table();
+
+      void load(const std::string&, int32_t);
+      int64_t size() const;
+      const real* row(int64_t) const;
+  };
+
+  char* formatReal(real, char*);
+  const char* parseReal(const char*, real&);
+}
+
+}
+
+#endif
@@ -55,12 +55,12 @@ echo "Training without polarization term..."
 
 echo
 echo "Do polarized word embedding..."
-./fasttext.x pwv -input "./newsgroups_polar.train" -output "./newsgroups_polar" -dim 20 -lr 0.05 -wordNgrams 1 -ws 6 -epoch 3 -minCount 1 -neg 20 -bucket 1000000 -minn 3 -maxn 6 -t 1e-4 -lrUpdateRate 100
+./fasttext.x pwv -input "./newsgroups_polar.train" -output "./newsgroups_polar" -dim 20 -lr 0.05 -wordNgrams 1 -ws 6 -epoch 3 -minCount 1 -neg 20 -bucket 1000000 -minn 3 -maxn 6 -t 1e-4 -lrUpdateRate 100 -vectorFormat both
 
 echo 
 echo "Training with pretrained polarized embedding"
 
-./fasttext.x supervised -input "./newsgroups.train" -output "./newsgroups" -dim 20 -lr 0.2 -wordNgrams 1 -minCount 1 -bucket 1000000 -epoch 100 -thread 8 -pretrainedVectors "./newsgroups_polar.vec"
+./fasttext.x supervised -input "./newsgroups.train" -output "./newsgroups" -dim 20 -lr 0.2 -wordNgrams 1 -minCount 1 -bucket 1000000 -epoch 100 -thread 8 -pretrainedVectors "./newsgroups_polar.bvec"
 ./fasttext.x test "./newsgroups.bin" "./newsgroups.test"
 
 